@@ -0,0 +1,289 @@
+#include "provided.h"
+#include "MyHash.h"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+using namespace std;
+
+// Run with --benchmark_out=results.json --benchmark_out_format=json (or build the bench target) and
+// compare two runs with Google Benchmark's tools/compare.py.
+
+const string WORDLIST = CRACKER_WORDLIST;
+
+/////////////////////////////////////////////////////////////
+// Corpus
+/////////////////////////////////////////////////////////////
+
+// plaintexts at three lengths, each with one that has a single solution and one that has lots.
+// every run encrypts them with the same seeds, so the ciphertexts never change between commits
+struct CorpusEntry {
+	const char* name;
+	const char* plaintext;
+};
+
+const CorpusEntry CORPUS[] = {
+	{ "short_unique",  "programming languages require careful thought" },
+	{ "short_many",    "she sells sea shells by the sea shore" },
+	{ "medium_unique", "my friend went to the store yesterday and bought some bread and milk for the week" },
+	{ "medium_many",   "we all like to eat red apples and pears" },
+	{ "long_unique",   "it was the best of times it was the worst of times it was the age of wisdom it was the "
+	                   "age of foolishness it was the epoch of belief it was the epoch of incredulity" },
+	{ "long_pangram",  "the quick brown fox jumps over the lazy dog while seven wizards quietly hex a jovial "
+	                   "frog near the big old barn" },
+};
+const int CORPUS_SIZE = sizeof(CORPUS) / sizeof(CORPUS[0]);
+const unsigned int CORPUS_SEED = 32;
+
+string corpusCiphertext(int i)
+{
+	return encrypt(CORPUS[i].plaintext, CORPUS_SEED + i);
+}
+
+// loading takes a while, so the benchmarks that only read the list share one per backend
+const WordList& sharedWordList(WordListBackend backend = WordListBackend::Index)
+{
+	static WordList* lists[2] = { nullptr, nullptr };
+	WordList*& list = lists[backend == WordListBackend::Dawg];
+	if (!list)
+	{
+		list = new WordList;
+		list->setBackend(backend);
+		if (!list->loadWordList(WORDLIST))
+			fprintf(stderr, "Unable to load word list file %s\n", WORDLIST.c_str());
+	}
+	return *list;
+}
+
+WordListBackend benchBackend(int64_t arg)
+{
+	return arg != 0 ? WordListBackend::Dawg : WordListBackend::Index;
+}
+
+const Decrypter& sharedDecrypter()
+{
+	static Decrypter* decrypter = nullptr;
+	if (!decrypter)
+	{
+		decrypter = new Decrypter;
+		if (!decrypter->load(WORDLIST))
+			fprintf(stderr, "Unable to load word list file %s\n", WORDLIST.c_str());
+	}
+	return *decrypter;
+}
+
+/////////////////////////////////////////////////////////////
+// WordList
+/////////////////////////////////////////////////////////////
+
+// from the text file (arg 0), from a saved index (arg 1), and into a dawg (arg 2). works on a copy of
+// the list, so an index saved next to the real one can't get picked up by the text run
+void BM_LoadWordList(benchmark::State& state)
+{
+	string copy = (filesystem::temp_directory_path() / "cracker_bench_wordlist.txt").string();
+	{
+		FILE* in = fopen(WORDLIST.c_str(), "rb");
+		FILE* out = fopen(copy.c_str(), "wb");
+		if (!in || !out)
+		{
+			if (in) fclose(in);
+			if (out) fclose(out);
+			state.SkipWithError("can't copy the word list");
+			return;
+		}
+		char buffer[65536];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+			fwrite(buffer, 1, n, out);
+		fclose(in);
+		fclose(out);
+	}
+	remove((copy + ".idx").c_str());
+	bool indexed = state.range(0) == 1;
+	WordListBackend backend = state.range(0) == 2 ? WordListBackend::Dawg : WordListBackend::Index;
+	if (indexed)
+	{
+		WordList list;
+		list.loadWordList(copy);
+		list.saveIndex(copy + ".idx");
+	}
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		WordList list;
+		list.setBackend(backend);
+		benchmark::DoNotOptimize(list.loadWordList(copy));
+		bytes = list.memoryUsage();
+	}
+	state.counters["bytes"] = static_cast<double>(bytes);
+	state.SetLabel(indexed ? "index" : backend == WordListBackend::Dawg ? "dawg" : "text");
+	remove((copy + ".idx").c_str());
+	remove(copy.c_str());
+}
+BENCHMARK(BM_LoadWordList)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+// cipher words with nothing, some, and most of their letters known
+const char* const FIND_QUERIES[][2] = {
+	{ "xqzvw",    "?????" },		// abcde, one of the biggest groups
+	{ "xqzvw",    "?r???" },
+	{ "xqzvwtp",  "s?????e" },
+	{ "xyzzyab",  "???????" },	// abccade
+	{ "qwertyui", "?an?i?g?" },
+};
+const int N_FIND_QUERIES = sizeof(FIND_QUERIES) / sizeof(FIND_QUERIES[0]);
+
+// the second arg picks the backend, 0 for the index and 1 for the dawg
+void BM_FindCandidates(benchmark::State& state)
+{
+	const WordList& list = sharedWordList(benchBackend(state.range(1)));
+	string cipherWord = FIND_QUERIES[state.range(0)][0];
+	string translation = FIND_QUERIES[state.range(0)][1];
+	vector<string_view> candidates;
+	string storage;
+	for (auto _ : state)
+	{
+		list.findCandidates(cipherWord, translation, candidates, storage);
+		benchmark::DoNotOptimize(candidates.data());
+	}
+	state.counters["candidates"] = static_cast<double>(candidates.size());
+	state.SetLabel(translation);
+}
+BENCHMARK(BM_FindCandidates)->ArgsProduct({ benchmark::CreateDenseRange(0, N_FIND_QUERIES - 1, 1), { 0, 1 } });
+
+// words in the list (arg 0), words that aren't (arg 1), and half of each (arg 2), in the index or the dawg
+void BM_Contains(benchmark::State& state)
+{
+	const WordList& list = sharedWordList(benchBackend(state.range(1)));
+	const vector<string> hits = { "the", "xylophone", "abracadabra", "Hello", "don't", "strawberry" };
+	const vector<string> misses = { "qwzx", "zzzzz", "thw", "strawbery", "hellos'", "xylophonez" };
+	vector<string> words;
+	if (state.range(0) != 1) words.insert(words.end(), hits.begin(), hits.end());
+	if (state.range(0) != 0) words.insert(words.end(), misses.begin(), misses.end());
+	for (auto _ : state)
+		for (const string& w : words)
+			benchmark::DoNotOptimize(list.contains(w));
+	state.SetItemsProcessed(state.iterations() * words.size());
+	state.SetLabel(state.range(0) == 0 ? "hits" : state.range(0) == 1 ? "misses" : "mixed");
+}
+BENCHMARK(BM_Contains)->ArgsProduct({ { 0, 1, 2 }, { 0, 1 } });
+
+/////////////////////////////////////////////////////////////
+// Translator and Tokenizer
+/////////////////////////////////////////////////////////////
+
+// what the crack does at every node: push a word, translate, pop it again
+void BM_TranslatorPushPop(benchmark::State& state)
+{
+	Translator t;
+	t.pushMapping("XYZ", "the");
+	string text = corpusCiphertext(4);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(t.pushMapping("ABCDEF", "friend"));
+		benchmark::DoNotOptimize(t.getTranslation(text));
+		t.popMapping();
+	}
+}
+BENCHMARK(BM_TranslatorPushPop);
+
+void BM_Tokenize(benchmark::State& state)
+{
+	Tokenizer tokenizer(",;:.!()[]{}-\"#$%^& 1234567890");
+	string text;
+	for (int i = 0; i < CORPUS_SIZE; ++i)
+		text += corpusCiphertext(i) + ". ";
+	bool views = state.range(0) != 0;
+	vector<string_view> tokens;
+	for (auto _ : state)
+	{
+		if (views)
+		{
+			tokenizer.tokenize(text, tokens);
+			benchmark::DoNotOptimize(tokens.data());
+		}
+		else
+			benchmark::DoNotOptimize(tokenizer.tokenize(text));
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+	state.SetLabel(views ? "views" : "strings");
+}
+BENCHMARK(BM_Tokenize)->Arg(0)->Arg(1);
+
+/////////////////////////////////////////////////////////////
+// MyHash
+/////////////////////////////////////////////////////////////
+
+vector<string> hashKeys(size_t n)
+{
+	mt19937 e(7);
+	vector<string> keys(n);
+	for (size_t i = 0; i < n; ++i)
+		for (unsigned int len = 3 + e() % 8; keys[i].size() < len; )
+			keys[i] += static_cast<char>('a' + e() % 26);
+	return keys;
+}
+
+void BM_MyHashInsert(benchmark::State& state)
+{
+	vector<string> keys = hashKeys(state.range(0));
+	for (auto _ : state)
+	{
+		MyHash<string, int> hash;
+		for (size_t i = 0; i < keys.size(); ++i)
+			hash.associate(keys[i], static_cast<int>(i));
+		benchmark::DoNotOptimize(hash.getNumItems());
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_MyHashInsert)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_MyHashFind(benchmark::State& state)
+{
+	vector<string> keys = hashKeys(state.range(0));
+	MyHash<string, int> hash;
+	for (size_t i = 0; i < keys.size(); i += 2)	// half of the lookups miss
+		hash.associate(keys[i], static_cast<int>(i));
+	for (auto _ : state)
+		for (size_t i = 0; i < keys.size(); ++i)
+			benchmark::DoNotOptimize(hash.find(keys[i]));
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_MyHashFind)->Arg(1 << 10)->Arg(1 << 16);
+
+/////////////////////////////////////////////////////////////
+// Decrypter
+/////////////////////////////////////////////////////////////
+
+void BM_Crack(benchmark::State& state)
+{
+	const Decrypter& decrypter = sharedDecrypter();
+	string ciphertext = corpusCiphertext(static_cast<int>(state.range(0)));
+	CrackResult result;
+	for (auto _ : state)
+		result = decrypter.crack(ciphertext, CrackOptions());
+	state.counters["solutions"] = static_cast<double>(result.solutions.size());
+	state.counters["nodes"] = static_cast<double>(result.stats.nodes);
+	state.SetLabel(CORPUS[state.range(0)].name);
+}
+BENCHMARK(BM_Crack)->DenseRange(0, CORPUS_SIZE - 1)->Unit(benchmark::kMillisecond);
+
+// the long messages, where annealing is meant to be used. solved says whether the best key was exactly
+// right, and knownWords how many words of its plaintext are in the list
+void BM_CrackAnneal(benchmark::State& state)
+{
+	const Decrypter& decrypter = sharedDecrypter();
+	string ciphertext = corpusCiphertext(static_cast<int>(state.range(0)));
+	AnnealResult result;
+	for (auto _ : state)
+		result = decrypter.crackAnneal(ciphertext);
+	state.counters["solved"] = !result.solutions.empty() && result.solutions[0].plaintext == CORPUS[state.range(0)].plaintext;
+	state.counters["knownWords"] = result.solutions.empty() ? 0 : static_cast<double>(result.solutions[0].knownWords);
+	state.counters["iterations"] = static_cast<double>(result.iterations);
+	state.SetLabel(CORPUS[state.range(0)].name);
+}
+BENCHMARK(BM_CrackAnneal)->DenseRange(CORPUS_SIZE - 2, CORPUS_SIZE - 1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,151 @@
+#ifndef CANDIDATE_CACHE_H
+#define CANDIDATE_CACHE_H
+
+#include "MyHash.h"
+#include <cctype>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/////////////////////////////////////////////////////////////
+// CandidateCache Interface
+/////////////////////////////////////////////////////////////
+
+// Remembers the candidate lists of the word list, so cracks of different messages that run into the
+// same pattern with the same known letters don't look it up again. Safe to share between threads:
+// the keys are spread over shards with a lock each. A shard that fills up evicts one list at a time with
+// the CLOCK algorithm: a list that was found since the hand last passed it gets a second chance.
+//
+// Lists the WordList handed out as views of its own words are kept as those views, so the cache has to
+// be cleared when that list goes away. Lists it copied into storage (the Dawg backend's) are kept as a
+// copy of that storage, and handed back the same way.
+class CandidateCache
+{
+public:
+	CandidateCache(unsigned long maxEntries)
+		:m_maxPerShard(maxEntries / N_SHARDS + 1)
+	{}
+
+	// copies the list for key into candidates, false if we don't have it. like WordList::findCandidates,
+	// a list of copies is put in storage and the candidates point there, otherwise storage is left empty
+	bool find(const std::string& key, std::vector<std::string_view>& candidates, std::string& storage)
+	{
+		Shard& shard = getShard(key);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		const unsigned int* index = shard.index.find(key);
+		if (!index) return false;
+		Entry& entry = shard.entries[*index];
+		entry.referenced = true;
+		const List* found = &entry.list;
+		candidates.assign(found->words.begin(), found->words.end());
+		storage = found->text;
+		for (size_t i = 0; i < storage.size(); i += key.size())	// every candidate has the key's length
+			candidates.push_back(std::string_view(storage.data() + i, key.size()));
+		return true;
+	}
+	// candidates and storage as WordList::findCandidates filled them in
+	void add(const std::string& key, const std::vector<std::string_view>& candidates, const std::string& storage)
+	{
+		List list;
+		if (storage.empty())
+			list.words = candidates;
+		else
+			for (size_t i = 0; i < candidates.size(); ++i)
+				list.text.append(candidates[i].data(), candidates[i].size());
+		Shard& shard = getShard(key);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		const unsigned int* index = shard.index.find(key);
+		if (index)	// another thread looked it up at the same time
+		{
+			shard.entries[*index].list = list;
+			return;
+		}
+		Entry entry = { key, list, false };
+		if (shard.entries.size() < m_maxPerShard)
+		{
+			shard.index.associate(key, static_cast<unsigned int>(shard.entries.size()));
+			shard.entries.push_back(entry);
+			return;
+		}
+		// full: the hand clears reference bits until it finds a list nobody found since its last turn
+		while (shard.entries[shard.hand].referenced)
+		{
+			shard.entries[shard.hand].referenced = false;
+			shard.hand = (shard.hand + 1) % shard.entries.size();
+		}
+		shard.index.remove(shard.entries[shard.hand].key);
+		shard.index.associate(key, static_cast<unsigned int>(shard.hand));
+		shard.entries[shard.hand] = entry;
+		shard.hand = (shard.hand + 1) % shard.entries.size();
+	}
+	void clear()
+	{
+		for (unsigned int i = 0; i < N_SHARDS; ++i)
+		{
+			std::lock_guard<std::mutex> guard(m_shards[i].lock);
+			m_shards[i].index.reset();
+			m_shards[i].entries.clear();
+			m_shards[i].hand = 0;
+		}
+	}
+
+	// the key for a cipher word and its current translation: known letters as themselves, unknown ones
+	// as an uppercase pattern ('A' for the first, 'B' for the next different one, ...), and anything
+	// else unchanged. two words with the same key always have the same candidates
+	static std::string makeKey(const std::string& cipherWord, const std::string& translation)
+	{
+		std::string key(translation.size(), '?');
+		char letters[26] = { 0 };
+		char next = 'A';
+		for (unsigned int i = 0; i < translation.size(); ++i)
+		{
+			unsigned char c = cipherWord[i], t = translation[i];
+			if (t != '?')
+				key[i] = static_cast<char>(tolower(t));
+			else if (isalpha(c))
+			{
+				char& letter = letters[toupper(c) - 'A'];
+				if (!letter) letter = next++;
+				key[i] = letter;
+			}
+		}
+		return key;
+	}
+
+	// C++11 syntax for preventing copying and assignment
+	CandidateCache(const CandidateCache&) = delete;
+	CandidateCache& operator=(const CandidateCache&) = delete;
+
+private:
+	static const unsigned int N_SHARDS = 16;
+
+	struct List {
+		std::vector<std::string_view> words;	// views into the word list
+		std::string                   text;		// or the words themselves, back to back
+	};
+
+	struct Entry {
+		std::string key;
+		List        list;
+		bool        referenced;	// found since the clock hand last went by
+	};
+
+	struct Shard {
+		Shard() :hand(0) {}
+		std::mutex                        lock;
+		MyHash<std::string, unsigned int> index;	// key -> its entry
+		std::vector<Entry>                entries;	// at most m_maxPerShard, in no particular order
+		size_t                            hand;		// the next entry to consider evicting
+	};
+
+	unsigned long m_maxPerShard;
+	Shard         m_shards[N_SHARDS];
+
+	Shard& getShard(const std::string& key)
+	{
+		return m_shards[std::hash<std::string>()(key) % N_SHARDS];
+	}
+};
+
+#endif // CANDIDATE_CACHE_H
@@ -0,0 +1,333 @@
+#ifndef DAWG_H
+#define DAWG_H
+
+#include "MyHash.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/////////////////////////////////////////////////////////////
+// Dawg Interface
+/////////////////////////////////////////////////////////////
+
+// A minimized directed acyclic word graph: a trie in which equal subtrees are stored once, so the
+// endings a big list repeats over and over (-ing, -ed, -'s, ...) cost next to nothing. It's built in
+// one pass over the sorted words (Daciuk et al.), then frozen into a single array of 32 bit edges:
+//
+//   bits 0-4   the letter, 0-25, or APOSTROPHE
+//   bit  5     a word ends after this edge
+//   bit  6     the last edge of its node
+//   bits 7-31  where the edges of the node it leads to start, 0 if that node has none
+//
+// A node is the run of edges from its start up to the one marked last, in letter order. Edge 0 is
+// never used, which is what lets 0 mean no children. Words are lowercase letters and apostrophes.
+//
+// Next to every edge is a mask of how many more letters the words through it can have (bit 31 for 31
+// or more), so a pattern search can turn back as soon as no word of its length is left ahead.
+class Dawg
+{
+public:
+	static const std::uint32_t APOSTROPHE = 26;
+	static const std::uint32_t MAX_EDGES  = 1u << 25;	// what fits in bits 7-31
+
+	Dawg() { clear(); }
+	void clear()
+	{
+		m_edges.assign(1, 0);
+		m_edges.shrink_to_fit();
+		m_remaining.assign(1, 0);
+		m_remaining.shrink_to_fit();
+		m_root = 0;
+		m_nWords = 0;
+	}
+	bool build(const std::vector<std::string_view>& sortedWords);	// sorted as strings. false if the list needs more than MAX_EDGES
+	bool contains(const char* word, std::size_t length) const;	// ignores case
+
+	// calls visit(word, length) for every word with the letter pattern of cipherWord that agrees with the
+	// letters translation knows ('?' for the ones it doesn't), in alphabetical order
+	template <typename Visit>
+	void forEachMatch(const std::string& cipherWord, const std::string& translation, Visit visit) const;
+
+	std::size_t size() const { return m_nWords; }
+	std::size_t memoryUsage() const { return (m_edges.capacity() + m_remaining.capacity()) * sizeof(std::uint32_t); }
+
+	// C++11 syntax for preventing copying and assignment
+	Dawg(const Dawg&) = delete;
+	Dawg& operator=(const Dawg&) = delete;
+
+private:
+	static const std::uint32_t LABEL_MASK  = 0x1F;
+	static const std::uint32_t FINAL       = 1u << 5;
+	static const std::uint32_t LAST        = 1u << 6;
+	static const unsigned int  TARGET_SHIFT = 7;
+	static const std::uint32_t ANY         = 0xFF;	// a label that matches every letter
+
+	// a node while building, before it has a place in m_edges
+	struct BuildNode {
+		BuildNode() :final(false) {}
+		bool                                          final;	// a word ends here
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;	// (label, child), in the order the words came
+	};
+
+	// the state of one forEachMatch
+	struct Match {
+		const std::string& cipherWord;
+		const std::string& translation;
+		std::string        word;			// the letters of the path so far
+		int                plainOf[26];		// cipher letter -> label it got on this path, -1 if none yet
+		int                cipherOf[26];	// label -> cipher letter that got it, -1 if none yet
+		Match(const std::string& cipherWord_, const std::string& translation_)
+			:cipherWord(cipherWord_), translation(translation_), word(cipherWord_.size(), '?')
+		{
+			for (int i = 0; i < 26; ++i) plainOf[i] = cipherOf[i] = -1;
+		}
+	};
+
+	std::vector<std::uint32_t> m_edges;
+	std::vector<std::uint32_t> m_remaining;	// per edge, bit n set if a word through it ends n letters after it
+	std::uint32_t              m_root;		// where the root's edges start, 0 if there are no words
+	std::size_t                m_nWords;
+
+	static std::uint32_t labelOf(unsigned char c)	// ANY for anything that can't be in a word
+	{
+		if (isalpha(c)) return static_cast<std::uint32_t>(tolower(c) - 'a');
+		return c == '\'' ? APOSTROPHE : ANY;
+	}
+	static std::uint32_t targetOf(std::uint32_t edge) { return edge >> TARGET_SHIFT; }
+	static std::uint32_t lengthBit(std::size_t n) { return 1u << (n < 31 ? n : 31); }
+
+	std::uint32_t getNode(std::vector<BuildNode>& nodes, std::vector<std::uint32_t>& unused) const;
+	void minimize(std::vector<BuildNode>& nodes, std::vector<std::uint32_t>& unused, MyHash<std::string, std::uint32_t>& registered,
+	              std::vector<std::uint32_t>& path, std::size_t keep) const;	// share or register the path's nodes below depth keep
+	bool freeze(const std::vector<BuildNode>& nodes);
+	std::uint32_t remainingOf(const std::vector<BuildNode>& nodes, std::uint32_t node, std::vector<std::uint32_t>& remaining,
+	                          std::vector<bool>& known) const;	// the lengths of the words below a node, bit n for n letters
+	template <typename Visit>
+	void matchFrom(Match& match, std::uint32_t node, std::size_t pos, Visit& visit) const;
+};
+
+/////////////////////////////////////////////////////////////
+// Dawg Implementation
+/////////////////////////////////////////////////////////////
+
+inline bool Dawg::build(const std::vector<std::string_view>& sortedWords)
+{
+	clear();
+	std::vector<BuildNode> nodes(1);	// node 0 is the root
+	std::vector<std::uint32_t> unused;	// nodes that turned out equal to a registered one, to reuse
+	MyHash<std::string, std::uint32_t> registered;	// every node we kept, by what it contains
+	std::vector<std::uint32_t> path(1, 0);	// the nodes along the last word, root first
+	std::string_view previous;
+	for (std::size_t w = 0; w < sortedWords.size(); ++w)
+	{
+		std::string_view word = sortedWords[w];
+		if (word.empty() || (m_nWords > 0 && word == previous)) continue;
+		std::size_t common = 0;
+		while (common < word.size() && common < previous.size() && word[common] == previous[common])
+			common++;
+		// nothing after the words share can change any more, since the words come sorted
+		minimize(nodes, unused, registered, path, common);
+		for (std::size_t i = common; i < word.size(); ++i)
+		{
+			std::uint32_t child = getNode(nodes, unused);
+			nodes[path.back()].edges.push_back(std::make_pair(labelOf(word[i]), child));
+			path.push_back(child);
+		}
+		nodes[path.back()].final = true;
+		previous = word;
+		m_nWords++;
+	}
+	minimize(nodes, unused, registered, path, 0);
+	return freeze(nodes);
+}
+
+inline std::uint32_t Dawg::getNode(std::vector<BuildNode>& nodes, std::vector<std::uint32_t>& unused) const
+{
+	if (unused.empty())
+	{
+		nodes.push_back(BuildNode());
+		return static_cast<std::uint32_t>(nodes.size() - 1);
+	}
+	std::uint32_t node = unused.back();
+	unused.pop_back();
+	return node;
+}
+
+inline void Dawg::minimize(std::vector<BuildNode>& nodes, std::vector<std::uint32_t>& unused, MyHash<std::string, std::uint32_t>& registered,
+                           std::vector<std::uint32_t>& path, std::size_t keep) const
+{
+	// deepest first, so a node's children are already shared when we look it up
+	while (path.size() > keep + 1)
+	{
+		std::uint32_t child = path.back();
+		path.pop_back();
+		std::string signature(1, nodes[child].final ? 'F' : 'N');
+		for (std::size_t i = 0; i < nodes[child].edges.size(); ++i)
+		{
+			signature += static_cast<char>(nodes[child].edges[i].first);
+			signature.append(reinterpret_cast<const char*>(&nodes[child].edges[i].second), sizeof(std::uint32_t));
+		}
+		const std::uint32_t* same = registered.find(signature);
+		if (same)
+		{
+			nodes[path.back()].edges.back().second = *same;
+			nodes[child] = BuildNode();
+			unused.push_back(child);
+		}
+		else
+			registered.associate(signature, child);
+	}
+}
+
+inline bool Dawg::freeze(const std::vector<BuildNode>& nodes)
+{
+	// give every node with edges a start, breadth first from the root, then write the edges out
+	std::vector<std::uint32_t> start(nodes.size(), 0);
+	std::vector<std::uint32_t> order;
+	std::size_t nEdges = 1;
+	if (!nodes[0].edges.empty())
+	{
+		start[0] = static_cast<std::uint32_t>(nEdges);
+		nEdges += nodes[0].edges.size();
+		order.push_back(0);
+	}
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		const BuildNode& node = nodes[order[i]];
+		for (std::size_t e = 0; e < node.edges.size(); ++e)
+		{
+			std::uint32_t child = node.edges[e].second;
+			if (nodes[child].edges.empty() || start[child] != 0) continue;	// a leaf, or already placed
+			if (nEdges + nodes[child].edges.size() > MAX_EDGES) return false;
+			start[child] = static_cast<std::uint32_t>(nEdges);
+			nEdges += nodes[child].edges.size();
+			order.push_back(child);
+		}
+	}
+
+	m_edges.assign(nEdges, 0);
+	m_remaining.assign(nEdges, 0);
+	std::vector<std::uint32_t> remaining(nodes.size(), 0);
+	std::vector<bool> known(nodes.size(), false);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		// the words came in string order, which puts an apostrophe first. label order puts it last
+		edges = nodes[order[i]].edges;
+		std::sort(edges.begin(), edges.end());
+		for (std::size_t e = 0; e < edges.size(); ++e)
+		{
+			std::uint32_t child = edges[e].second;
+			std::uint32_t edge = edges[e].first | (start[child] << TARGET_SHIFT);
+			if (nodes[child].final) edge |= FINAL;
+			if (e + 1 == edges.size()) edge |= LAST;
+			m_edges[start[order[i]] + e] = edge;
+			m_remaining[start[order[i]] + e] = (nodes[child].final ? lengthBit(0) : 0) | remainingOf(nodes, child, remaining, known);
+		}
+	}
+	m_root = start[0];
+	return true;
+}
+
+inline std::uint32_t Dawg::remainingOf(const std::vector<BuildNode>& nodes, std::uint32_t node, std::vector<std::uint32_t>& remaining,
+                                       std::vector<bool>& known) const
+{
+	if (known[node]) return remaining[node];
+	std::uint32_t lengths = 0;
+	for (std::size_t e = 0; e < nodes[node].edges.size(); ++e)
+	{
+		std::uint32_t child = nodes[node].edges[e].second;
+		std::uint32_t below = (nodes[child].final ? lengthBit(0) : 0) | remainingOf(nodes, child, remaining, known);
+		lengths |= (below << 1) | (below & lengthBit(31));	// one letter longer, and 31 or more stays that
+	}
+	known[node] = true;
+	remaining[node] = lengths;
+	return lengths;
+}
+
+inline bool Dawg::contains(const char* word, std::size_t length) const
+{
+	std::uint32_t node = m_root;
+	bool final = false;
+	for (std::size_t i = 0; i < length; ++i)
+	{
+		std::uint32_t label = labelOf(word[i]);
+		if (node == 0 || label == ANY) return false;	// the word goes on past every word we have
+		for (std::uint32_t e = node; ; ++e)
+		{
+			std::uint32_t edge = m_edges[e];
+			if ((edge & LABEL_MASK) == label)
+			{
+				final = (edge & FINAL) != 0;
+				node = targetOf(edge);
+				break;
+			}
+			if ((edge & LAST) || (edge & LABEL_MASK) > label) return false;	// they're in order
+		}
+	}
+	return final;
+}
+
+template <typename Visit>
+void Dawg::forEachMatch(const std::string& cipherWord, const std::string& translation, Visit visit) const
+{
+	if (cipherWord.empty() || translation.size() != cipherWord.size() || m_root == 0) return;
+	Match match(cipherWord, translation);
+	matchFrom(match, m_root, 0, visit);
+}
+
+template <typename Visit>
+void Dawg::matchFrom(Match& match, std::uint32_t node, std::size_t pos, Visit& visit) const
+{
+	// what position pos can be: an apostrophe for an apostrophe, and for a letter whatever the translation
+	// or an earlier position with the same cipher letter says, or else any letter
+	unsigned char c = match.cipherWord[pos];
+	int cipher = -1;
+	std::uint32_t want;
+	if (c == '\'') want = APOSTROPHE;
+	else if (!isalpha(c)) return;
+	else
+	{
+		cipher = toupper(c) - 'A';
+		unsigned char t = match.translation[pos];
+		if (isalpha(t)) want = static_cast<std::uint32_t>(tolower(t) - 'a');
+		else if (match.plainOf[cipher] >= 0) want = static_cast<std::uint32_t>(match.plainOf[cipher]);
+		else want = ANY;
+	}
+	bool lastPos = (pos + 1 == match.cipherWord.size());
+	std::uint32_t needed = lengthBit(match.cipherWord.size() - pos - 1);	// letters left after this one
+
+	for (std::uint32_t e = node; ; ++e)
+	{
+		std::uint32_t edge = m_edges[e];
+		std::uint32_t label = edge & LABEL_MASK;
+		if (want != ANY && label > want) break;	// the edges are in order, so it isn't here
+		bool fits = (want == ANY ? label != APOSTROPHE : label == want) && (m_remaining[e] & needed);
+		// and the pattern: different cipher letters get different letters, in both directions
+		if (fits && cipher >= 0)
+			fits = (match.plainOf[cipher] < 0 || match.plainOf[cipher] == static_cast<int>(label))
+				&& (match.cipherOf[label] < 0 || match.cipherOf[label] == cipher);
+		if (fits)
+		{
+			match.word[pos] = (label == APOSTROPHE ? '\'' : static_cast<char>('a' + label));
+			if (lastPos)
+			{
+				if (edge & FINAL) visit(match.word.data(), match.word.size());
+			}
+			else if (targetOf(edge) != 0)
+			{
+				bool fresh = (cipher >= 0 && match.plainOf[cipher] < 0);
+				if (fresh) { match.plainOf[cipher] = static_cast<int>(label); match.cipherOf[label] = cipher; }
+				matchFrom(match, targetOf(edge), pos + 1, visit);
+				if (fresh) { match.plainOf[cipher] = -1; match.cipherOf[label] = -1; }
+			}
+		}
+		if (edge & LAST) break;
+	}
+}
+
+#endif // DAWG_H
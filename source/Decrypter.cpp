@@ -1,126 +1,1522 @@
 #include "provided.h"
+#include "WorkStealingPool.h"
+#include "EnglishStats.h"
+#include "Stats.h"
+#include "CandidateCache.h"
+#include "TranspositionTable.h"
+#include "MyHash.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
-#include <unordered_set>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <cmath>
 using namespace std;
 
+// how many levels of the candidate tree are handed out as separate tasks in a parallel crack.
+// below this depth a task just runs the sequential search on its own.
+const unsigned int PARALLEL_SPLIT_DEPTH = 2;
+// how many search nodes go by between looks at the clock, the node budget and the cancel flag
+const unsigned int LIMIT_CHECK_INTERVAL = 64;
+// every plaintext letter, as a domain
+const std::uint32_t ALL_LETTERS = (1u << 26) - 1;
+// the text of a message that is only there to find keys: its translation is the key itself
+const string CIPHER_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+// each time crackParts needs more keys of a part, it searches the part again for this many times the ones it has
+const size_t PART_KEYS_GROWTH = 4;
+// what crackAnneal adds to the score for each letter of a word the list knows
+const double ANNEAL_WORD_BONUS = 1.0;
+// the temperature a crackAnneal climb starts at and cools down to, in the same log10 units as the score
+const double ANNEAL_START_TEMPERATURE = 10.0;
+const double ANNEAL_END_TEMPERATURE   = 0.05;
+
+// random numbers for zobrist hashing the search states: one per (cipher letter, plaintext letter) pair,
+// one per plaintext letter and one per cipher letter, xored together for whatever a state has
+struct ZobristKeys {
+	ZobristKeys()
+	{
+		mt19937_64 e(0x5EED);
+		for (int c = 0; c < 26; ++c)
+			for (int p = 0; p < 26; ++p)
+				mapped[c][p] = e();
+		for (int p = 0; p < 26; ++p)
+			used[p] = e();
+		for (int c = 0; c < 26; ++c)
+			unmapped[c] = e();
+	}
+	std::uint64_t mapped[26][26];
+	std::uint64_t used[26];
+	std::uint64_t unmapped[26];
+	static std::uint64_t wild(unsigned int word)	// for each word given up on, made up on the spot since messages have any number
+	{
+		std::uint64_t z = (word + 1) * 0x9E3779B97F4A7C15ull;	// splitmix64
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+const ZobristKeys ZOBRIST;
+
 class DecrypterImpl
 {
 public:
 	DecrypterImpl();
 	~DecrypterImpl();
     bool load(string filename);	// load words to use in decrypting
-    vector<string> crack(const string& ciphertext);	// return a vector of all possible translations
+	void setThreadCount(unsigned int nThreads);	// 1 cracks on the calling thread, 0 uses every core
+	void setCacheSize(size_t maxEntries);	// share candidate lists between cracks, 0 for no cache
+	void setWordListBackend(WordListBackend backend) { m_backend = backend; }	// takes effect at the next load
+    CrackResult crack(const string& ciphertext, const CrackOptions& options) const;	// return a vector of all possible translations
+    bool crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options) const;	// hand each translation to visit as it's found
+    bool crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const;	// same, and fill in stats
+    BestCrackResult crackBest(const string& ciphertext, size_t k, const CrackOptions& options) const;	// the k most english looking translations
+    SharedKeyResult crackShared(const vector<string>& ciphertexts, const CrackOptions& options) const;	// every key that translates all of them
+    AnnealResult crackAnneal(const string& ciphertext, const CrackOptions& options) const;	// the best keys simulated annealing finds
 private:
-	WordList*   m_wordList;
-	Tokenizer   m_tokenizer;
-	Translator* m_translator;
-
-	void   crackHelper(string ciphertext_message, string cipherWord, string candidate, vector<string>& output);
-	bool   containsChar(const string& word, const char& character) const;	// returns true if a word contains a character
-	string getNextWord(const string& ciphertext) const;	// returns the most translated version of the next word we should translate
-	bool   isValidSoFar(const string& message) const;	// true if all words translated SO FAR are valid
-	bool   isFullyTranslated(const string& message) const;	// true if no '?' left, false if there are questions marks 
+	// where the solutions of one crack go and when to stop, shared by all of its workers
+	struct SearchLimits {
+		SearchLimits(const SolutionVisitor& visit_, const CrackOptions& options)
+			:visit(visit_), hasDeadline(options.timeout.count() > 0), maxNodes(options.maxNodes), nodes(0),
+			 cancel(options.cancel), maxResults(options.maxResults), nResults(0),
+			 propagate(options.propagate), order(options.order), stopped(cancel && cancel->load()), nSearches(0), unknownWords(0), excluded(0)
+		{
+			if (options.transpositionEntries > 0)
+				table.reset(new TranspositionTable(options.transpositionEntries));
+			if (hasDeadline)
+				deadline = chrono::steady_clock::now() + options.timeout;
+		}
+		bool checksLimits() const { return hasDeadline || maxNodes != 0 || cancel; }
+		const SolutionVisitor&           visit;
+		mutex                            visitLock;		// workers take turns calling visit
+		bool                             hasDeadline;
+		chrono::steady_clock::time_point deadline;
+		unsigned long long               maxNodes;		// 0 for no limit
+		atomic<unsigned long long>       nodes;			// searched by every worker, as of their last check
+		const atomic<bool>*              cancel;		// nullptr if the caller can't cancel
+		size_t                           maxResults;	// 0 for no limit
+		size_t                           nResults;		// results handed to visit so far
+		bool                             propagate;		// run propagate() after every push
+		WordOrder                        order;			// how getNextWord picks
+		atomic<bool>                     stopped;		// visit or a limit said stop, every worker should unwind
+		unique_ptr<TranspositionTable>   table;			// states known to have no solutions, nullptr if off
+		unsigned int                     nSearches;		// messages searched with these limits so far, so their states never mix
+		size_t                           unknownWords;	// how many words the solutions of this search leave out of the list
+		std::uint32_t                    excluded;		// plaintext letters no cipher letter can be, one bit each. only propagate enforces it
+	};
+
+	// a ciphertext tokenized once per crack. none of this changes while searching
+	struct CipherMessage {
+		struct LetterUse {
+			unsigned int word;		// index into words
+			unsigned int count;		// how many times the letter appears in that word
+		};
+		string            text;				// the whole ciphertext
+		vector<string>    words;			// its words, in order
+		vector<LetterUse> uses[26];			// the words each cipher letter appears in
+		vector<unsigned int> letterCounts;	// letters in each word
+	};
+
+	// the words a search got as copies from the word list (the dawg backend's), each copied once more
+	// to stay put until the search is over. every worker has its own, so they need no lock
+	struct WordCopies {
+		static const size_t BLOCK_SIZE = 1 << 16;
+		WordCopies() :used(BLOCK_SIZE) {}
+		vector<unique_ptr<char[]>>       blocks;
+		size_t                           used;	// in the last block
+		MyHash<string_view, string_view> words;	// each word to its copy
+	};
+
+	// the mutable half of a search: the mapping so far, plus how many letters of each word
+	// it leaves unknown. every worker of a parallel crack has its own
+	struct SearchState {
+		SearchState(const CipherMessage& message_, SearchLimits& limits_)
+			:message(message_), limits(limits_), unknown(message_.letterCounts), unknownTotal(0), nodesSinceCheck(0), nResults(0),
+			 candidateCounts(message_.words.size(), 0), wild(message_.words.size(), false), wildLeft(limits_.unknownWords)
+		{
+			for (unsigned int i = 0; i < unknown.size(); ++i)
+				unknownTotal += unknown[i];
+			for (int i = 0; i < 26; ++i)
+				domains[i] = ALL_LETTERS;
+		}
+		const CipherMessage& message;
+		SearchLimits&        limits;
+		Translator           translator;
+		vector<unsigned int> unknown;		// letters of each word that are still unmapped
+		unsigned int         unknownTotal;	// letters of the whole message that are still unmapped
+		vector<char>         mappedLog;		// cipher letters newly mapped by each push, oldest first
+		vector<unsigned int> frames;		// size of mappedLog before each push
+		vector<int>          frameWild;		// for each frame, the word it gave up on, -1 for a push
+		vector<unsigned int> completed;		// scratch space for words a push finishes
+		unsigned int         nodesSinceCheck;	// nodes searched since we last checked the limits
+		unsigned long long   nResults;		// solutions this worker found
+		CrackStats           stats;			// this worker's counters
+		std::uint32_t        domains[26];	// plaintext letters each cipher letter can still be, one bit each
+		vector<string_view>  scratch;		// candidate buffer for propagate
+		string               found;			// storage for the word list's copies of the last candidates
+		WordCopies           copies;		// the copies the candidates handed out point into
+		vector<size_t>       candidateCounts;	// candidates of each unfinished word, as of the last propagate
+		vector<char>         wild;			// words allowed to be anything, kept out of unknownTotal
+		size_t               wildLeft;		// words that can still be given up on
+	};
+
+	// one partial key of a best-first crack
+	struct KeyNode {
+		char          key[26];	// cipher letter -> lowercase plaintext letter, '?' if unmapped
+		std::uint32_t used;		// plaintext letters already taken, one bit each
+		double        bound;	// the best score any completion of this key could reach
+		unsigned int  depth;	// words guessed to get here
+	};
+
+	// a branch and bound crack for the k best scoring solutions
+	struct BestSearch {
+		BestSearch(const CipherMessage& message_, SearchLimits& limits)
+			:message(message_), clock(message_, limits), k(0), beamWidth(0), skippedCandidates(false)
+		{
+			for (int i = 0; i < 26; ++i) letterCounts[i] = 0;
+		}
+		const CipherMessage&   message;
+		SearchState            clock;				// only used to check the limits
+		size_t                 k;
+		size_t                 beamWidth;			// candidates tried per word, 0 for all
+		vector<int>            letterRuns;			// the message's cipher letters, with -1 before each run of them
+		unsigned int           letterCounts[26];	// how often each cipher letter appears
+		vector<ScoredSolution> best;				// the best k so far, a heap with the worst on top
+		bool                   skippedCandidates;	// the beam width cut something off
+	};
+
+	// a ciphertext as crackAnneal scores it: each different word once
+	struct AnnealMessage {
+		vector<string>       words;			// uppercase
+		vector<unsigned int> counts;		// how many times each word appears
+		vector<unsigned int> letterCounts;	// letters in each word
+		vector<unsigned int> uses[26];		// the words each cipher letter appears in
+		vector<int>          letters;		// the cipher letters the message has
+	};
+
+	// one climb of a crackAnneal: a whole key, and the score of every word under it
+	struct AnnealKey {
+		char                               plainOf[26];	// cipher letter -> plaintext letter, every letter used once
+		char                               cipherOf[26];	// plaintext letter -> cipher letter
+		vector<double>                     wordScores;	// already multiplied by the word's count
+		double                             score;
+		vector<unsigned int>               scoredAt;	// the swap that last rescored each word
+		unsigned int                       nSwaps;
+		vector<pair<unsigned int, double>> changed;		// (word, score before) for everything the last swap rescored
+	};
+
+	// everything the climbs of one crackAnneal share
+	struct AnnealJob {
+		AnnealJob(const CipherMessage& message_, const AnnealMessage& words_, SearchLimits& limits, unsigned long long iterations_)
+			:message(message_), words(words_), iterations(iterations_), nIterations(0)
+		{
+			clocks.emplace_back(new SearchState(message, limits));
+		}
+		const CipherMessage&            message;
+		const AnnealMessage&            words;
+		unsigned long long              iterations;	// per climb
+		atomic<unsigned long long>      nIterations;	// done by every climb so far
+		vector<unique_ptr<SearchState>> clocks;		// one per worker, only used to check the limits
+		mutex                           foundLock;
+		vector<AnnealSolution>          found;		// the best key of each climb
+	};
+
+	typedef vector<pair<unsigned int, string_view>> MappingPath;	// (word index, candidate) pairs pushed from the root, an empty candidate for a word given up on
+	struct PartKey {
+		string        cipher, plain;	// for pushMapping
+		std::uint32_t letters;			// the plaintext letters it uses, one bit each
+	};
+	typedef vector<PartKey> PartKeys;	// the keys of one part of a message
+
+	// the parts of a message that share no cipher letters, and the keys of each found so far. see crackParts
+	struct MessageParts {
+		MessageParts(const SolutionVisitor& collect, const CrackOptions& options, size_t nParts)
+			:limits(collect, options), messages(nParts), keys(nParts), complete(nParts, false),
+			 nodes(nParts, 0), excludingNodes(nParts, 0), current(0) {}
+		SearchLimits          limits;		// one clock, node budget, cancel flag and table for every part search
+		vector<CipherMessage> messages;		// each part as a message whose text is the alphabet, so its solutions are keys
+		vector<PartKeys>      keys;			// of each part, in the order they were found
+		vector<bool>          complete;		// every key of the part is in keys
+		vector<unsigned long long> nodes;	// searched in each part for any key
+		vector<unsigned long long> excludingNodes;	// searched in each part for keys that fit the ones picked before it
+		MyHash<string, unsigned int> seen;	// every key found so far, so searching a part again only adds the new ones
+		unsigned int          current;		// the part being searched
+	};
+
+	// everything the workers of one parallel crack share. each worker only touches its own slot
+	struct ParallelCrack {
+		ParallelCrack(const CipherMessage& message_, SearchLimits& limits, unsigned int nThreads)
+			:message(message_), pool(nThreads)
+		{
+			for (unsigned int i = 0; i < pool.size(); ++i)
+				states.emplace_back(new SearchState(message, limits));
+		}
+		const CipherMessage&            message;
+		WorkStealingPool                pool;
+		vector<unique_ptr<SearchState>> states;		// one search state per worker
+	};
+
+	WordList*    m_wordList;
+	WordListBackend m_backend;	// what load builds
+	Tokenizer    m_tokenizer;
+	unsigned int m_nThreads;
+	unique_ptr<CandidateCache> m_cache;	// nullptr unless setCacheSize turned it on
+
+	void   tokenizeMessage(const string& ciphertext, CipherMessage& message) const;
+	void   indexMessage(CipherMessage& message) const;	// fill in the letter uses and counts of message.words
+	bool   crackMessage(const CipherMessage& message, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const;
+	void   searchMessage(const CipherMessage& message, SearchLimits& limits, CrackStats& stats) const;	// the whole search of one message, on every thread we have
+	vector<vector<unsigned int>> findParts(const CipherMessage& message) const;	// the words in groups that share no cipher letters
+	bool   crackParts(const CipherMessage& message, const vector<vector<unsigned int>>& parts, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const;
+	void   combineKeys(SearchState& state, MessageParts& parts, unsigned int part, std::uint32_t taken, CrackStats& stats) const;	// every way of picking one key per part that is still a key
+	bool   findMoreKeys(SearchState& state, MessageParts& parts, unsigned int part, std::uint32_t taken, size_t fits, bool& allFound, CrackStats& stats) const;
+	void   crackBelow(SearchState& state) const;	// propagate, then report the translation or search deeper
+	void   crackLevel(SearchState& state) const;	// visit every translation below the current mapping
+	void   crackHelper(SearchState& state, unsigned int word, string_view candidate) const;
+	void   crackTask(ParallelCrack& job, unsigned int worker, const MappingPath& path) const;	// run one subtree of a parallel crack
+	void   crackParallel(const CipherMessage& message, SearchLimits& limits, CrackStats& stats) const;	// adds every worker's counters to stats
+	bool   pushWord(SearchState& state, unsigned int word, string_view candidate) const;	// map a word to a candidate, false (and nothing pushed) if that breaks anything
+	void   popWord(SearchState& state) const;	// undo the last successful pushWord or markWild
+	void   markWild(SearchState& state, unsigned int word) const;	// give up on finding word in the list, as a frame popWord undoes
+	void   popWordsTo(SearchState& state, size_t depth) const { while (state.frames.size() > depth) popWord(state); }
+	bool   propagate(SearchState& state) const;	// narrow the domains and push forced words, false if that shows a dead end
+	void   findCandidates(SearchState& state, unsigned int word, vector<string_view>& candidates) const;	// candidates that fit the current domains
+	void   keepCandidates(SearchState& state, vector<string_view>& candidates) const;	// point candidates at the state's own copies of them
+	bool   shouldStop(SearchState& state) const;	// true once a limit says the whole crack should unwind
+	void   addResult(SearchState& state) const;	// hand the current, fully translated message to the visitor
+	unsigned int getNextWord(const SearchState& state) const;	// returns the index of the next word we should translate
+	std::uint64_t getStateKey(const SearchState& state) const;	// zobrist hash of everything the rest of the search depends on
+	bool   isValidSoFar(SearchState& state) const;	// true if all the words the last push finished are valid, or could be given up on
+	bool   isFullyTranslated(const SearchState& state) const { return state.unknownTotal == 0; }	// true if no '?' left
+	bool   messageWordsValid(const CipherMessage& message) const { return countSymbolWords(message) == 0; }	// false if a word without letters isn't a word
+	size_t countSymbolWords(const CipherMessage& message) const;	// words without letters that aren't words
+	void   crackBestLevel(BestSearch& search, const KeyNode& node) const;	// branch and bound below one key
+	double scoreBound(const BestSearch& search, const KeyNode& node) const;	// best score any completion of the key could get
+	string translateWord(const string& word, const char key[26]) const;
+	void   annealClimb(AnnealJob& job, SearchState& clock, unsigned int climb) const;	// one restart of crackAnneal, from a random key
+	double annealWordScore(const AnnealMessage& words, unsigned int word, const char plainOf[26], string& plain) const;	// one appearance of a word under a key
+	double annealSwap(const AnnealMessage& words, AnnealKey& key, int a, int b, string& plain) const;	// swap the plaintext letters of two cipher letters, returns what that added to the score
+	void   annealUndo(AnnealKey& key, int a, int b) const;	// take back the last annealSwap
 };
 
 DecrypterImpl::DecrypterImpl()
-	:m_tokenizer(",;:.!()[]{}-\"#$%^& 1234567890")	// create the tokenizer with all of these different separators
+	:m_backend(WordListBackend::Index), m_tokenizer(",;:.!()[]{}-\"#$%^& 1234567890"), m_nThreads(1)	// create the tokenizer with all of these different separators
 {
 	m_wordList   = new WordList;
-	m_translator = new Translator;
 }
 
 DecrypterImpl::~DecrypterImpl()
 {
 	delete m_wordList;
-	delete m_translator;
 }
 
 bool DecrypterImpl::load(string filename)
 {
+	if (m_cache) m_cache->clear();	// its lists point into the old word list
 	delete m_wordList;
 	m_wordList = new WordList;
+	m_wordList->setBackend(m_backend);
 	return m_wordList->loadWordList(filename);
 }
 
-vector<string> DecrypterImpl::crack(const string& ciphertext)
+void DecrypterImpl::setThreadCount(unsigned int nThreads)
+{
+	if (nThreads == 0)
+		nThreads = thread::hardware_concurrency();
+	m_nThreads = (nThreads == 0 ? 1 : nThreads);	// hardware_concurrency() may not know
+}
+
+void DecrypterImpl::setCacheSize(size_t maxEntries)
+{
+	if (maxEntries == 0)
+		m_cache.reset();
+	else
+		m_cache.reset(new CandidateCache(static_cast<unsigned long>(maxEntries)));
+}
+
+CrackResult DecrypterImpl::crack(const string& ciphertext, const CrackOptions& options) const
+{
+	CrackResult result;
+	vector<string>& output = result.solutions;
+	result.truncated = !crack(ciphertext, [&output](const string& plaintext) {
+		output.push_back(plaintext);
+		return true;
+	}, options, result.stats);
+	std::sort(output.begin(), output.end());	// i can't get myhash to store in a sorted list, so i do this lazy thing instead to return a sorted vector
+	return result;
+}
+
+bool DecrypterImpl::crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options) const
+{
+	CrackStats stats;
+	return crack(ciphertext, visit, options, stats);
+}
+
+bool DecrypterImpl::crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const
+{
+	stats = CrackStats();
+	Stats::Scope scope(&stats);	// the workers point at their own, and get merged in at the end
+	CipherMessage message;
+	tokenizeMessage(ciphertext, message);
+	return crackMessage(message, visit, options, stats);
+}
+
+SharedKeyResult DecrypterImpl::crackShared(const vector<string>& ciphertexts, const CrackOptions& options) const
+{
+	SharedKeyResult result;
+	Stats::Scope scope(&result.stats);
+
+	// all of their words make up one message, so every word of every message constrains the same key. the
+	// text we "translate" is the alphabet, which turns each solution into the key itself
+	CipherMessage message;
+	{
+		Stats::Timer timer(&CrackStats::tokenizeTime);
+		message.text = CIPHER_ALPHABET;
+		vector<string_view> words;
+		for (unsigned int i = 0; i < ciphertexts.size(); ++i)
+		{
+			m_tokenizer.tokenize(ciphertexts[i], words);
+			message.words.insert(message.words.end(), words.begin(), words.end());
+		}
+		indexMessage(message);
+	}
+
+	vector<SharedKeySolution>& output = result.solutions;
+	result.truncated = !crackMessage(message, [&output, &ciphertexts](const string& translatedAlphabet) {
+		SharedKeySolution solution;
+		solution.key = translatedAlphabet;
+		string cipherLetters, plainLetters;
+		for (int i = 0; i < 26; ++i)
+		{
+			solution.key[i] = static_cast<char>(tolower(solution.key[i]));	// '?' stays '?'
+			if (solution.key[i] != '?') { cipherLetters += char('A' + i); plainLetters += solution.key[i]; }
+		}
+		Translator translator;
+		translator.pushMapping(cipherLetters, plainLetters);
+		for (unsigned int i = 0; i < ciphertexts.size(); ++i)
+			solution.plaintexts.push_back(translator.getTranslation(ciphertexts[i]));
+		output.push_back(solution);
+		return true;
+	}, options, result.stats);
+	sort(output.begin(), output.end(), [](const SharedKeySolution& a, const SharedKeySolution& b) { return a.plaintexts < b.plaintexts; });
+	return result;
+}
+
+bool DecrypterImpl::crackMessage(const CipherMessage& message, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const
+{
+	if (message.words.empty()) return true;	// nothing to translate
+
+	size_t symbolWords = countSymbolWords(message);	// these are unknown whatever the key
+	if (symbolWords > options.unknownWords) return true;
+
+	if (options.unknownWords == 0)
+	{
+		vector<vector<unsigned int>> parts = findParts(message);
+		if (parts.size() > 1)
+			return crackParts(message, parts, visit, options, stats);
+	}
+	// with unknown words allowed, search once for each number of them, fewest first. each search only
+	// reports the solutions with exactly that many, so none comes out twice. the parts aren't split up
+	// then, since they'd have to share the unknown words between them
+	SearchLimits limits(visit, options);
+	for (size_t n = symbolWords; n <= options.unknownWords && !limits.stopped; ++n)
+	{
+		limits.unknownWords = n - symbolWords;
+		searchMessage(message, limits, stats);
+	}
+	return !limits.stopped;
+}
+
+void DecrypterImpl::searchMessage(const CipherMessage& message, SearchLimits& limits, CrackStats& stats) const
+{
+	limits.nSearches++;
+	SearchState state(message, limits);	// every crack starts from an empty mapping
+	if (m_nThreads > 1 && !isFullyTranslated(state))
+		crackParallel(message, limits, stats);
+	else
+	{
+		{
+			Stats::Scope searchScope(&state.stats);
+			crackBelow(state);
+		}
+		Stats::merge(stats, state.stats);
+	}
+}
+
+vector<vector<unsigned int>> DecrypterImpl::findParts(const CipherMessage& message) const
+{
+	// union find over the cipher letters: every word joins all of its letters into one set
+	int parent[26];
+	for (int i = 0; i < 26; ++i) parent[i] = i;
+	auto root = [&parent](int letter) {
+		while (parent[letter] != letter)
+			letter = parent[letter] = parent[parent[letter]];
+		return letter;
+	};
+	vector<int> firstLetter(message.words.size(), -1);
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+		for (unsigned int j = 0; j < message.words[i].size(); ++j)
+		{
+			unsigned char c = message.words[i][j];
+			if (!isalpha(c)) continue;
+			int letter = toupper(c) - 'A';
+			if (firstLetter[i] < 0) firstLetter[i] = letter;
+			else parent[root(letter)] = root(firstLetter[i]);
+		}
+
+	// then a part per set, in the order their first words come. words without letters are in none
+	vector<vector<unsigned int>> parts;
+	int partOfRoot[26];
+	for (int i = 0; i < 26; ++i) partOfRoot[i] = -1;
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+	{
+		if (firstLetter[i] < 0) continue;
+		int& part = partOfRoot[root(firstLetter[i])];
+		if (part < 0)
+		{
+			part = static_cast<int>(parts.size());
+			parts.push_back(vector<unsigned int>());
+		}
+		parts[part].push_back(i);
+	}
+	return parts;
+}
+
+bool DecrypterImpl::crackParts(const CipherMessage& message, const vector<vector<unsigned int>>& parts, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const
+{
+	// parts that share no cipher letters only constrain each other through the plaintext letters they use, so
+	// search each one on its own for its keys and combine them. the work adds up instead of multiplying. a
+	// part's keys are only looked for once a combination has used up the ones we have, so the first
+	// solutions go out long before every key is known, and a limit still leaves us with the ones so far
+	MessageParts* split = nullptr;
+	SolutionVisitor collect = [&split](const string& translatedAlphabet) {
+		if (split->seen.find(translatedAlphabet)) return true;	// an earlier search of the part had it. parts map different letters, so no two parts share a key
+		split->seen.associate(translatedAlphabet, split->current);
+		PartKey key;
+		key.letters = 0;
+		for (int i = 0; i < 26; ++i)
+			if (translatedAlphabet[i] != '?')
+			{
+				key.cipher += CIPHER_ALPHABET[i];
+				key.plain += translatedAlphabet[i];
+				key.letters |= 1u << (tolower(static_cast<unsigned char>(translatedAlphabet[i])) - 'a');
+			}
+		split->keys[split->current].push_back(key);
+		return true;
+	};
+	MessageParts messageParts(collect, options, parts.size());
+	split = &messageParts;
+	for (unsigned int p = 0; p < parts.size(); ++p)
+	{
+		CipherMessage& part = messageParts.messages[p];
+		part.text = CIPHER_ALPHABET;
+		for (unsigned int i = 0; i < parts[p].size(); ++i)
+			part.words.push_back(message.words[parts[p][i]]);
+		indexMessage(part);
+	}
+
+	CrackOptions outputOptions(options);
+	outputOptions.transpositionEntries = 0;	// only the part searches need a table
+	SearchLimits output(visit, outputOptions);	// the combined solutions go out through this one
+	SearchState state(message, output);
+	combineKeys(state, messageParts, 0, 0, stats);
+	return !output.stopped;
+}
+
+void DecrypterImpl::combineKeys(SearchState& state, MessageParts& parts, unsigned int part, std::uint32_t taken, CrackStats& stats) const
+{
+	if (part == parts.keys.size())
+	{
+		addResult(state);
+		return;
+	}
+	const PartKeys& keys = parts.keys[part];
+	size_t fits = 0;		// keys so far that use none of the letters taken
+	bool allFound = false;	// every key of the part that fits is in keys
+	for (unsigned int i = 0; !shouldStop(state); ++i)
+	{
+		while (i == keys.size() && !parts.complete[part] && !allFound)	// used up the keys we have, look for more
+			if (!findMoreKeys(state, parts, part, taken, fits, allFound, stats))
+				return;
+		if (i == keys.size())	// every key that fits has had its turn
+			return;
+		if (keys[i].letters & taken)	// an earlier part's key took one of its letters
+			continue;
+		fits++;
+		state.translator.pushMapping(keys[i].cipher, keys[i].plain);	// can't fail, the parts map different cipher letters
+		combineKeys(state, parts, part + 1, taken | keys[i].letters, stats);
+		state.translator.popMapping();
+	}
+}
+
+bool DecrypterImpl::findMoreKeys(SearchState& state, MessageParts& parts, unsigned int part, std::uint32_t taken, size_t fits, bool& allFound, CrackStats& stats) const
+{
+	// the search of a part can't pick up where it stopped, so search it again from the start, for a few times
+	// more keys than we have. that's either any keys, or just the ones that fit what the earlier parts took,
+	// which is faster when few do but only good for this combination. searching for those never gets to take
+	// longer than searching for any keys has, so a part still costs about one search of it in the end
+	SearchLimits& limits = parts.limits;
+	bool excluding = (taken != 0 && limits.propagate && parts.excludingNodes[part] <= parts.nodes[part]);
+	size_t have = (excluding ? fits : parts.keys[part].size());
+	size_t before = parts.keys[part].size();
+	limits.maxResults = max<size_t>(1, have * PART_KEYS_GROWTH);
+	limits.nResults = 0;
+	limits.stopped = false;
+	limits.excluded = (excluding ? taken : 0);
+	limits.nodes = state.limits.nodes.load();	// the node budget covers both the part searches and combining
+	limits.nSearches = part;	// every search of a part gets the same number, so they share its dead ends
+	parts.current = part;
+	unsigned long long nodes = stats.nodes;
+	searchMessage(parts.messages[part], limits, stats);
+	(excluding ? parts.excludingNodes : parts.nodes)[part] += stats.nodes - nodes + 1;
+	state.limits.nodes = limits.nodes.load();
+
+	if (limits.stopped && limits.nResults < limits.maxResults)	// a limit, not the number of keys we asked for
+	{
+		state.limits.stopped = true;
+		return false;
+	}
+	if (excluding && limits.stopped && parts.keys[part].size() == before)	// nothing new fit, so next time look for any keys
+		parts.excludingNodes[part] = parts.nodes[part] + 1;
+	if (!limits.stopped)	// it found every key there is
+	{
+		if (excluding)
+			allFound = true;
+		else
+			parts.complete[part] = true;
+	}
+	return true;
+}
+
+BestCrackResult DecrypterImpl::crackBest(const string& ciphertext, size_t k, const CrackOptions& options) const
+{
+	BestCrackResult result;
+	Stats::Scope scope(&result.stats);
+	CipherMessage message;
+	tokenizeMessage(ciphertext, message);
+	if (message.words.empty() || k == 0 || !messageWordsValid(message)) return result;
+
+	SolutionVisitor noVisitor;	// solutions are collected in the BestSearch instead
+	SearchLimits limits(noVisitor, options);
+	BestSearch search(message, limits);
+	search.k = k;
+	search.beamWidth = options.beamWidth;
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+	{
+		const string& word = message.words[i];
+		bool inRun = false;
+		for (unsigned int j = 0; j < word.size(); ++j)
+		{
+			unsigned char c = word[j];
+			if (!isalpha(c)) { inRun = false; continue; }
+			if (!inRun) search.letterRuns.push_back(-1);
+			search.letterRuns.push_back(toupper(c) - 'A');
+			search.letterCounts[toupper(c) - 'A']++;
+			inRun = true;
+		}
+	}
+
+	KeyNode root;
+	for (int i = 0; i < 26; ++i) root.key[i] = '?';
+	root.used = 0;
+	root.depth = 0;
+	root.bound = scoreBound(search, root);
+	crackBestLevel(search, root);
+	Stats::merge(result.stats, search.clock.stats);
+
+	result.solutions = search.best;
+	sort(result.solutions.begin(), result.solutions.end(), [](const ScoredSolution& a, const ScoredSolution& b) {
+		return a.score > b.score || (a.score == b.score && a.plaintext < b.plaintext);
+	});
+	result.truncated = limits.stopped || search.skippedCandidates;
+	return result;
+}
+
+void DecrypterImpl::crackBestLevel(BestSearch& search, const KeyNode& node) const
 {
-	string curr = getNextWord(ciphertext);	// get the next word to evaluate
-	string currTranslated = m_translator->getTranslation(curr);		// get the translated version of our next word to evaluate
-	vector<string> candidates = m_wordList->findCandidates(curr, currTranslated);	// find valid candidates for our word
-	if (candidates.empty()) return vector<string>();	// if no candidates, return an empty vector
-	vector<string> output;	// create a vector to hold any correct translations
+	const CipherMessage& message = search.message;
+	if (shouldStop(search.clock)) return;
+	CrackStats& stats = search.clock.stats;
+	stats.nodes++;
+	if (node.depth > stats.maxDepth)
+		stats.maxDepth = node.depth;
+
+	// how much of each word this key leaves unknown, recounted since keys aren't pushed and popped here
+	unsigned int curr(0), mostUnknown(0);
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+	{
+		const string& word = message.words[i];
+		unsigned int unknown = 0;
+		for (unsigned int j = 0; j < word.size(); ++j)
+			if (isalpha(static_cast<unsigned char>(word[j])) && node.key[toupper(static_cast<unsigned char>(word[j])) - 'A'] == '?')
+				unknown++;
+		// branch on the word with the most unknown letters, the longest on ties
+		if (unknown > mostUnknown || (unknown == mostUnknown && word.size() > message.words[curr].size()))
+		{
+			curr = i;
+			mostUnknown = unknown;
+		}
+	}
+	if (mostUnknown == 0)	// complete, and its bound is its exact score
+	{
+		Translator translator;
+		string cipherLetters, plainLetters;
+		for (int i = 0; i < 26; ++i)
+			if (node.key[i] != '?') { cipherLetters += char('A' + i); plainLetters += node.key[i]; }
+		translator.pushMapping(cipherLetters, plainLetters);
+		ScoredSolution solution = { translator.getTranslation(message.text), node.bound };
+		auto worse = [](const ScoredSolution& a, const ScoredSolution& b) { return a.score > b.score; };
+		search.best.push_back(solution);	// a heap with the worst of the best on top
+		push_heap(search.best.begin(), search.best.end(), worse);
+		if (search.best.size() > search.k)
+		{
+			pop_heap(search.best.begin(), search.best.end(), worse);
+			search.best.pop_back();
+		}
+		return;
+	}
+
+	const string& cipherWord = message.words[curr];
+	vector<string_view> candidates;
+	string found;	// the candidates are only used below, so the list's copies can stay here
+	m_wordList->findCandidates(cipherWord, translateWord(cipherWord, node.key), candidates, found);
+	vector<KeyNode> children;
 	for (unsigned int i = 0; i < candidates.size(); ++i)
 	{
-		crackHelper(ciphertext, curr, candidates[i], output);
+		KeyNode child = node;
+		child.depth++;
+		bool consistent = true;
+		for (unsigned int j = 0; j < cipherWord.size() && consistent; ++j)
+		{
+			unsigned char c = cipherWord[j];
+			if (!isalpha(c) || child.key[toupper(c) - 'A'] != '?') continue;	// non-letters and letters already mapped this way
+			int plain = candidates[i][j] - 'a';
+			if (child.used & (1u << plain))
+				consistent = false;	// some other cipher letter already maps there
+			child.key[toupper(c) - 'A'] = candidates[i][j];
+			child.used |= 1u << plain;
+		}
+
+		// check every word this candidate finished, just like isValidSoFar
+		for (unsigned int j = 0; j < cipherWord.size() && consistent; ++j)
+		{
+			unsigned char c = cipherWord[j];
+			if (!isalpha(c) || node.key[toupper(c) - 'A'] != '?') continue;
+			const vector<CipherMessage::LetterUse>& uses = message.uses[toupper(c) - 'A'];
+			for (unsigned int u = 0; u < uses.size() && consistent; ++u)
+			{
+				string translated = translateWord(message.words[uses[u].word], child.key);
+				if (translated.find('?') == string::npos && !m_wordList->contains(translated))
+					consistent = false;
+			}
+		}
+		if (!consistent) continue;
+		child.bound = scoreBound(search, child);
+		children.push_back(child);
 	}
-	std::sort(output.begin(), output.end());	// i can't get myhash to store in a sorted list, so i do this lazy thing instead to return a sorted vector
-	return output;
+
+	// most promising first, so good solutions turn up early and raise the bar for everything after
+	sort(children.begin(), children.end(), [](const KeyNode& a, const KeyNode& b) { return a.bound > b.bound; });
+	if (search.beamWidth != 0 && children.size() > search.beamWidth)
+	{
+		children.resize(search.beamWidth);
+		search.skippedCandidates = true;	// one of them might have led somewhere better
+	}
+	for (unsigned int i = 0; i < children.size(); ++i)
+	{
+		// once we hold k solutions, a branch has to beat the worst of them to matter. the children are
+		// sorted, so if this one can't, none of the rest can either
+		if (search.best.size() == search.k && children[i].bound <= search.best.front().score)
+			break;
+		crackBestLevel(search, children[i]);
+	}
+}
+
+string DecrypterImpl::translateWord(const string& word, const char key[26]) const
+{
+	string translated(word);
+	for (unsigned int i = 0; i < translated.size(); ++i)
+		if (isalpha(static_cast<unsigned char>(translated[i])))
+			translated[i] = key[toupper(static_cast<unsigned char>(translated[i])) - 'A'];
+	return translated;
+}
+
+double DecrypterImpl::scoreBound(const BestSearch& search, const KeyNode& node) const
+{
+	// exact for the letters the key maps, and the best case for the ones it doesn't
+	const EnglishStats& stats = EnglishStats::get();
+	double score = 0;
+
+	// the letters: the unmapped cipher letters have to take distinct unused plaintext letters, and the
+	// best way to do that gives the most frequent cipher letter the most common plaintext letter, etc.
+	vector<unsigned int> unmappedCounts;
+	vector<double> unusedLetters;
+	for (int i = 0; i < 26; ++i)
+	{
+		if (search.letterCounts[i] != 0)
+		{
+			if (node.key[i] != '?')
+				score += search.letterCounts[i] * stats.letter(node.key[i] - 'a');
+			else
+				unmappedCounts.push_back(search.letterCounts[i]);
+		}
+		if (!(node.used & (1u << i)))
+			unusedLetters.push_back(stats.letter(i));
+	}
+	sort(unmappedCounts.begin(), unmappedCounts.end(), greater<unsigned int>());
+	sort(unusedLetters.begin(), unusedLetters.end(), greater<double>());
+	for (unsigned int i = 0; i < unmappedCounts.size() && i < unusedLetters.size(); ++i)
+		score += unmappedCounts[i] * unusedLetters[i];
+
+	// the pairs of letters next to each other
+	const vector<int>& runs = search.letterRuns;
+	for (unsigned int i = 1; i < runs.size(); ++i)
+	{
+		if (runs[i] < 0 || runs[i - 1] < 0) continue;	// start of a run, no pair
+		char a = node.key[runs[i - 1]], b = node.key[runs[i]];
+		if (a != '?' && b != '?') score += stats.lift(a - 'a', b - 'a');
+		else if (a != '?')        score += stats.maxLiftFrom(a - 'a');
+		else if (b != '?')        score += stats.maxLiftTo(b - 'a');
+		else                      score += stats.maxLift();
+	}
+	return score;
+}
+
+AnnealResult DecrypterImpl::crackAnneal(const string& ciphertext, const CrackOptions& options) const
+{
+	AnnealResult result;
+	CipherMessage message;
+	tokenizeMessage(ciphertext, message);
+
+	// a word that shows up again costs nothing extra to score, so keep each one once with a count
+	AnnealMessage words;
+	MyHash<string, unsigned int> seen;
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+	{
+		if (message.letterCounts[i] == 0) continue;	// the key can't change how it scores
+		string word = message.words[i];
+		for (unsigned int j = 0; j < word.size(); ++j)
+			word[j] = static_cast<char>(toupper(static_cast<unsigned char>(word[j])));
+		unsigned int* index = seen.find(word);
+		if (index) { words.counts[*index]++; continue; }
+		seen.associate(word, static_cast<unsigned int>(words.words.size()));
+		words.words.push_back(word);
+		words.counts.push_back(1);
+		words.letterCounts.push_back(message.letterCounts[i]);
+	}
+	for (unsigned int i = 0; i < words.words.size(); ++i)
+	{
+		std::uint32_t letters = 0;
+		for (unsigned int j = 0; j < words.words[i].size(); ++j)
+			if (isalpha(static_cast<unsigned char>(words.words[i][j])))
+				letters |= 1u << (words.words[i][j] - 'A');
+		for (int c = 0; c < 26; ++c)
+			if (letters & (1u << c)) words.uses[c].push_back(i);
+	}
+	for (int c = 0; c < 26; ++c)
+		if (!words.uses[c].empty()) words.letters.push_back(c);
+	if (words.letters.empty() || options.restarts == 0 || options.iterations == 0) return result;
+
+	SolutionVisitor noVisitor;	// the climbs collect their keys in the job instead
+	SearchLimits limits(noVisitor, options);
+	AnnealJob job(message, words, limits, options.iterations);
+	if (m_nThreads > 1 && options.restarts > 1)
+	{
+		WorkStealingPool pool(m_nThreads);
+		for (unsigned int i = 1; i < pool.size(); ++i)
+			job.clocks.emplace_back(new SearchState(message, limits));
+		for (unsigned int i = 0; i < options.restarts; ++i)
+			pool.submit([this, &job, i](unsigned int worker) { annealClimb(job, *job.clocks[worker], i); });
+		pool.wait();
+	}
+	else
+	{
+		for (unsigned int i = 0; i < options.restarts; ++i)
+			annealClimb(job, *job.clocks[0], i);
+	}
+
+	// climbs often agree, keep the first of each plaintext
+	vector<AnnealSolution>& solutions = result.solutions;
+	solutions.swap(job.found);
+	sort(solutions.begin(), solutions.end(), [](const AnnealSolution& a, const AnnealSolution& b) {
+		return a.score > b.score || (a.score == b.score && a.plaintext < b.plaintext);
+	});
+	solutions.erase(unique(solutions.begin(), solutions.end(), [](const AnnealSolution& a, const AnnealSolution& b) {
+		return a.plaintext == b.plaintext;
+	}), solutions.end());
+	if (options.maxResults != 0 && solutions.size() > options.maxResults)
+		solutions.resize(options.maxResults);
+	result.truncated = limits.stopped;
+	result.iterations = job.nIterations;
+	return result;
+}
+
+void DecrypterImpl::annealClimb(AnnealJob& job, SearchState& clock, unsigned int climb) const
+{
+	if (shouldStop(clock)) return;	// a limit was hit before this climb got a turn
+	const AnnealMessage& words = job.words;
+	mt19937 e(climb);	// the same climbs every run, however many threads share them
+	uniform_real_distribution<double> chance(0, 1);
+
+	AnnealKey key;
+	string alphabet = "abcdefghijklmnopqrstuvwxyz";
+	shuffle(alphabet.begin(), alphabet.end(), e);
+	for (int c = 0; c < 26; ++c)
+	{
+		key.plainOf[c] = alphabet[c];
+		key.cipherOf[alphabet[c] - 'a'] = static_cast<char>('A' + c);
+	}
+	string plain;
+	key.score = 0;
+	key.wordScores.resize(words.words.size());
+	key.scoredAt.assign(words.words.size(), 0);
+	key.nSwaps = 0;
+	for (unsigned int i = 0; i < words.words.size(); ++i)
+	{
+		key.wordScores[i] = words.counts[i] * annealWordScore(words, i, key.plainOf, plain);
+		key.score += key.wordScores[i];
+	}
+	char best[26];	// the best key of the climb so far
+	double bestScore = key.score;
+	copy(key.plainOf, key.plainOf + 26, best);
+
+	// each step gives one of the message's cipher letters a different plaintext letter, and whichever
+	// cipher letter had that one takes the old one. worse keys get taken less and less as it cools
+	double cooling = pow(ANNEAL_END_TEMPERATURE / ANNEAL_START_TEMPERATURE, 1.0 / job.iterations);
+	double temperature = ANNEAL_START_TEMPERATURE;
+	unsigned long long step = 0;
+	for (; step < job.iterations && !shouldStop(clock); ++step, temperature *= cooling)
+	{
+		int a = words.letters[e() % words.letters.size()];
+		int b = key.cipherOf[e() % 26] - 'A';
+		if (a == b) continue;
+		double delta = annealSwap(words, key, a, b, plain);
+		if (delta >= 0 || chance(e) < exp(delta / temperature))
+		{
+			if (key.score > bestScore)
+			{
+				bestScore = key.score;
+				copy(key.plainOf, key.plainOf + 26, best);
+			}
+		}
+		else
+			annealUndo(key, a, b);
+	}
+	job.nIterations += step;
+
+	// then from the best key, take every swap that still helps until none does. cooling can stop a
+	// letter or two short of a key that plain climbing finds right away
+	for (int c = 0; c < 26; ++c)
+		if (key.plainOf[c] != best[c]) annealSwap(words, key, c, key.cipherOf[best[c] - 'a'] - 'A', plain);
+	for (bool improved = true; improved && !shouldStop(clock); )
+	{
+		improved = false;
+		for (int a : words.letters)
+			for (int b = 0; b < 26; ++b)
+			{
+				if (a == b || (!words.uses[b].empty() && b < a)) continue;	// each pair once
+				if (annealSwap(words, key, a, b, plain) > 1e-9) improved = true;
+				else annealUndo(key, a, b);
+			}
+	}
+
+	AnnealSolution solution;
+	solution.key.assign(26, '?');
+	string cipherLetters, plainLetters;
+	for (int c : words.letters)
+	{
+		solution.key[c] = key.plainOf[c];
+		cipherLetters += static_cast<char>('A' + c);
+		plainLetters += key.plainOf[c];
+	}
+	Translator translator;
+	translator.pushMapping(cipherLetters, plainLetters);
+	solution.plaintext = translator.getTranslation(job.message.text);
+	solution.score = 0;
+	solution.knownWords = 0;
+	for (unsigned int i = 0; i < words.words.size(); ++i)	// summed again, so rounding from all the deltas doesn't count
+	{
+		solution.score += words.counts[i] * annealWordScore(words, i, key.plainOf, plain);
+		if (m_wordList->contains(plain)) solution.knownWords += words.counts[i];
+	}
+	lock_guard<mutex> guard(job.foundLock);
+	job.found.push_back(solution);
+}
+
+double DecrypterImpl::annealSwap(const AnnealMessage& words, AnnealKey& key, int a, int b, string& plain) const
+{
+	swap(key.plainOf[a], key.plainOf[b]);
+	key.cipherOf[key.plainOf[a] - 'a'] = static_cast<char>('A' + a);
+	key.cipherOf[key.plainOf[b] - 'a'] = static_cast<char>('A' + b);
+	key.nSwaps++;	// wraps long after any real climb ends
+	key.changed.clear();
+	double delta = 0;
+	for (int c : { a, b })
+		for (unsigned int w : words.uses[c])
+		{
+			if (key.scoredAt[w] == key.nSwaps) continue;	// has both letters
+			key.scoredAt[w] = key.nSwaps;
+			key.changed.push_back(make_pair(w, key.wordScores[w]));
+			key.wordScores[w] = words.counts[w] * annealWordScore(words, w, key.plainOf, plain);
+			delta += key.wordScores[w] - key.changed.back().second;
+		}
+	key.score += delta;
+	return delta;
+}
+
+void DecrypterImpl::annealUndo(AnnealKey& key, int a, int b) const
+{
+	swap(key.plainOf[a], key.plainOf[b]);
+	key.cipherOf[key.plainOf[a] - 'a'] = static_cast<char>('A' + a);
+	key.cipherOf[key.plainOf[b] - 'a'] = static_cast<char>('A' + b);
+	for (unsigned int i = 0; i < key.changed.size(); ++i)
+	{
+		key.score += key.changed[i].second - key.wordScores[key.changed[i].first];
+		key.wordScores[key.changed[i].first] = key.changed[i].second;
+	}
+	key.changed.clear();
+}
+
+double DecrypterImpl::annealWordScore(const AnnealMessage& words, unsigned int word, const char plainOf[26], string& plain) const
+{
+	// the same letter model as crackBest, with every run of letters scored as a word of its own
+	const EnglishStats& stats = EnglishStats::get();
+	const string& cipher = words.words[word];
+	plain = cipher;
+	double score = 0;
+	int previous = -1;
+	for (unsigned int i = 0; i < cipher.size(); ++i)
+	{
+		unsigned char c = cipher[i];
+		if (!isalpha(c)) { previous = -1; continue; }
+		int p = plainOf[c - 'A'] - 'a';
+		plain[i] = static_cast<char>('a' + p);
+		score += (previous < 0 ? stats.first(p) : stats.next(previous, p));
+		previous = p;
+	}
+	if (m_wordList->contains(plain))
+		score += ANNEAL_WORD_BONUS * words.letterCounts[word];
+	return score;
+}
+
+size_t DecrypterImpl::countSymbolWords(const CipherMessage& message) const
+{
+	// words without any letters are as translated as they will ever get, so check them up front
+	size_t count = 0;
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+		if (message.letterCounts[i] == 0 && !m_wordList->contains(message.words[i]))
+			count++;
+	return count;
+}
+
+void DecrypterImpl::tokenizeMessage(const string& ciphertext, CipherMessage& message) const
+{
+	Stats::Timer timer(&CrackStats::tokenizeTime);
+	message.text = ciphertext;
+	message.words = m_tokenizer.tokenize(ciphertext);
+	indexMessage(message);
 }
 
-void DecrypterImpl::crackHelper(string ciphertext_message, string cipherWord, string candidate, vector <string>& output)
+void DecrypterImpl::indexMessage(CipherMessage& message) const
+{
+	message.letterCounts.assign(message.words.size(), 0);
+	for (unsigned int i = 0; i < message.words.size(); ++i)
+	{
+		unsigned int counts[26] = { 0 };
+		const string& word = message.words[i];
+		for (unsigned int j = 0; j < word.size(); ++j)
+			if (isalpha(static_cast<unsigned char>(word[j])))
+				counts[toupper(static_cast<unsigned char>(word[j])) - 'A']++;
+		for (int c = 0; c < 26; ++c)
+		{
+			if (counts[c] == 0) continue;
+			CipherMessage::LetterUse use = { i, counts[c] };
+			message.uses[c].push_back(use);
+			message.letterCounts[i] += counts[c];
+		}
+	}
+}
+
+void DecrypterImpl::crackBelow(SearchState& state) const
+{
+	if (state.limits.propagate && !propagate(state)) return;	// some word or letter has nothing left it could be
+	if (isFullyTranslated(state))	// if fully translated and valid, then this IS a completely valid translation of the cipher
+		addResult(state);
+	else if (!state.limits.table)	// if not fully translated but valid so far, recurse
+		crackLevel(state);
+	else	// same, unless another way here already found there's nothing below
+	{
+		TranspositionTable& table = *state.limits.table;
+		std::uint64_t key = getStateKey(state);
+		if (table.contains(key))
+		{
+			state.stats.transpositionHits++;
+			return;
+		}
+		state.stats.transpositionMisses++;
+		unsigned long long before = state.nResults;
+		crackLevel(state);
+		if (state.nResults == before && !state.limits.stopped)	// a stop means we didn't see all of it
+			table.add(key);
+	}
+}
+
+std::uint64_t DecrypterImpl::getStateKey(const SearchState& state) const
+{
+	// what's left to search only depends on which words are unfinished, what their letters map to or that
+	// they're still unmapped, and on which plaintext letters are taken. letters that only appear in finished
+	// words just take theirs, so mappings that differ only in those get the same key. excluded letters are as
+	// good as taken
+	string key = state.translator.getTranslation(CIPHER_ALPHABET);
+	std::uint64_t hash = state.limits.nSearches * 0x9E3779B97F4A7C15ull;
+	for (int p = 0; p < 26; ++p)
+		if (state.limits.excluded & (1u << p)) hash ^= ZOBRIST.used[p];
+	for (int c = 0; c < 26; ++c)
+	{
+		bool unfinished = false;	// in some word that isn't finished
+		const vector<CipherMessage::LetterUse>& uses = state.message.uses[c];
+		for (unsigned int u = 0; u < uses.size() && !unfinished; ++u)
+			unfinished = (state.unknown[uses[u].word] > 0);
+		if (key[c] == '?')	// the unmapped letters of the unfinished words say which words those are
+		{
+			if (unfinished) hash ^= ZOBRIST.unmapped[c];
+			continue;
+		}
+		int p = key[c] - 'A';
+		hash ^= ZOBRIST.used[p];
+		if (unfinished) hash ^= ZOBRIST.mapped[c][p];
+	}
+	for (unsigned int i = 0; i < state.frameWild.size(); ++i)	// and which words we gave up on, which fixes how many more we can
+		if (state.frameWild[i] >= 0) hash ^= ZobristKeys::wild(state.frameWild[i]);
+	return hash;
+}
+
+void DecrypterImpl::crackLevel(SearchState& state) const
+{
+	unsigned int curr = getNextWord(state);	// get the next word to evaluate
+	vector<string_view> candidates;
+	findCandidates(state, curr, candidates);	// find valid candidates for our word
+	for (unsigned int i = 0; i < candidates.size() && !shouldStop(state); ++i)
+	{
+		crackHelper(state, curr, candidates[i]);
+	}
+	if (state.wildLeft > 0 && !shouldStop(state))	// and the branch where it's none of them
+	{
+		size_t depth = state.frames.size();
+		markWild(state, curr);
+		crackBelow(state);
+		popWordsTo(state, depth);
+	}
+}
+
+void DecrypterImpl::crackHelper(SearchState& state, unsigned int word, string_view candidate) const
 {	
-	// if this current candidate is not translatable, return. If It is, push the entire new mapping onto the stack at once
-	if (!m_translator->pushMapping(cipherWord, candidate)) return;	
-	
-	string translatedMessage = m_translator->getTranslation(ciphertext_message);	// translate the entire ciphertext message using this translation
-	
-	// compute these bools so we don't have to repeatedly dive into functions unnecessarily for the next few if statements
-	bool fullyTranslated = isFullyTranslated(translatedMessage);
-	bool validSoFar = isValidSoFar(translatedMessage);
-
-	// if not valid, then pop the mapping and return false
-	if (!validSoFar)
-	{
-		m_translator->popMapping();
-		return;
+	state.stats.nodes++;
+	size_t depth = state.frames.size();
+	// if this current candidate is not translatable or finishes a word that isn't real, return
+	if (!pushWord(state, word, candidate)) return;	
+	crackBelow(state);
+	popWordsTo(state, depth);	// get rid of the current mapping, and any words propagate forced
+}
+
+void DecrypterImpl::findCandidates(SearchState& state, unsigned int word, vector<string_view>& candidates) const
+{
+	const string& cipherWord = state.message.words[word];
+	string translation = state.translator.getTranslation(cipherWord);
+	if (!m_cache)
+		m_wordList->findCandidates(cipherWord, translation, candidates, state.found);
+	else
+	{
+		string key = CandidateCache::makeKey(cipherWord, translation);
+		if (!m_cache->find(key, candidates, state.found))
+		{
+			m_wordList->findCandidates(cipherWord, translation, candidates, state.found);
+			m_cache->add(key, candidates, state.found);
+		}
 	}
+	Stats::count(&CrackStats::candidates, candidates.size());
 
-	// if not fully translated but valid so far, recurse
-	if (validSoFar && !fullyTranslated) {
-		vector<string> temp = crack(ciphertext_message);	
-		output.insert(output.end(), temp.begin(), temp.end());	// add whatever we get from recursion to this output vector
-		m_translator->popMapping();	// pop the current mapping, regardless of what temp has in it
+	// drop the ones that would give some letter a value outside its domain. without propagate the domains
+	// are never narrowed
+	if (state.limits.propagate)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < candidates.size(); ++i)
+		{
+			bool fits = true;
+			for (unsigned int j = 0; j < cipherWord.size() && fits; ++j)
+			{
+				unsigned char c = cipherWord[j];
+				if (isalpha(c) && !(state.domains[toupper(c) - 'A'] & (1u << (candidates[i][j] - 'a'))))
+					fits = false;
+			}
+			if (fits) candidates[kept++] = candidates[i];
+		}
+		candidates.resize(kept);
 	}
+	if (!state.found.empty())	// copies that the next lookup overwrites
+		keepCandidates(state, candidates);
+}
+
+void DecrypterImpl::keepCandidates(SearchState& state, vector<string_view>& candidates) const
+{
+	WordCopies& copies = state.copies;
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const string_view* kept = copies.words.find(candidates[i]);
+		if (kept)
+		{
+			candidates[i] = *kept;
+			continue;
+		}
+		size_t length = candidates[i].size();
+		if (copies.used + length > WordCopies::BLOCK_SIZE)	// words are short, so a fresh block always has room
+		{
+			copies.blocks.emplace_back(new char[WordCopies::BLOCK_SIZE]);
+			copies.used = 0;
+		}
+		char* copy = copies.blocks.back().get() + copies.used;
+		memcpy(copy, candidates[i].data(), length);
+		copies.used += length;
+		candidates[i] = string_view(copy, length);
+		copies.words.associate(candidates[i], candidates[i]);
+	}
+}
+
+bool DecrypterImpl::propagate(SearchState& state) const
+{
+	const CipherMessage& message = state.message;
+	static const string ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	for (;;)
+	{
+		// start from the mapping: a mapped letter can only be what it maps to, an unmapped one anything not taken
+		string key = state.translator.getTranslation(ALPHABET);
+		std::uint32_t taken = state.limits.excluded;
+		for (int c = 0; c < 26; ++c)
+			if (key[c] != '?') taken |= 1u << (tolower(static_cast<unsigned char>(key[c])) - 'a');
+		for (int c = 0; c < 26; ++c)
+			state.domains[c] = (key[c] != '?' ? 1u << (tolower(static_cast<unsigned char>(key[c])) - 'a') : ALL_LETTERS & ~taken);
+
+		// narrow every unmapped letter down to what the candidates of its words have there, until nothing changes
+		vector<pair<unsigned int, string_view>> forced;	// words down to one candidate
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			forced.clear();
+			// while some words can still be given up on, a word can only rule a letter out together with more
+			// words than that. misses counts, for each cipher letter and plaintext letter, the words that do
+			unsigned char misses[26][26];
+			if (state.wildLeft > 0) memset(misses, 0, sizeof(misses));
+			for (unsigned int w = 0; w < message.words.size(); ++w)
+			{
+				if (state.unknown[w] == 0 || state.wild[w]) continue;
+				findCandidates(state, w, state.scratch);
+				state.candidateCounts[w] = state.scratch.size();	// the last pass leaves these up to date for getNextWord
+				if (state.scratch.empty())	// nothing fits this word any more
+				{
+					if (state.wildLeft == 0) return false;
+					markWild(state, w);
+					changed = true;
+					continue;
+				}
+				bool mayBeWild = state.wildLeft > 0;
+				if (state.scratch.size() == 1 && !mayBeWild) forced.push_back(make_pair(w, state.scratch[0]));
 
-	// if fully translated and valid, then this IS a completely valid translation of the cipher
-	if (fullyTranslated && validSoFar) {
-		m_translator->popMapping();	// get rid of the current mapping
-		output.push_back(translatedMessage);	// add this message to the translated vector
+				const string& cipherWord = message.words[w];
+				std::uint32_t seen[26];	// letters the candidates put at each cipher letter
+				for (unsigned int j = 0; j < cipherWord.size(); ++j)
+					if (isalpha(static_cast<unsigned char>(cipherWord[j]))) seen[toupper(static_cast<unsigned char>(cipherWord[j])) - 'A'] = 0;
+				for (size_t i = 0; i < state.scratch.size(); ++i)
+					for (unsigned int j = 0; j < cipherWord.size(); ++j)
+						if (isalpha(static_cast<unsigned char>(cipherWord[j])))
+							seen[toupper(static_cast<unsigned char>(cipherWord[j])) - 'A'] |= 1u << (state.scratch[i][j] - 'a');
+				for (unsigned int j = 0; j < cipherWord.size(); ++j)
+				{
+					if (!isalpha(static_cast<unsigned char>(cipherWord[j]))) continue;
+					int c = toupper(static_cast<unsigned char>(cipherWord[j])) - 'A';
+					if (mayBeWild)
+					{
+						std::uint32_t missed = state.domains[c] & ~seen[c];
+						seen[c] = state.domains[c];	// count each letter of the word once
+						for (int p = 0; missed; ++p, missed >>= 1)
+							if ((missed & 1) && misses[c][p] < 255) misses[c][p]++;
+					}
+					else if ((state.domains[c] & seen[c]) != state.domains[c])	// never empty, the candidates all fit the domain
+					{
+						state.domains[c] &= seen[c];
+						changed = true;
+					}
+				}
+			}
+			if (state.wildLeft > 0)
+				for (int c = 0; c < 26; ++c)
+				{
+					if (key[c] != '?' || message.uses[c].empty()) continue;
+					for (int p = 0; p < 26; ++p)
+						if (misses[c][p] > state.wildLeft && (state.domains[c] & (1u << p)))
+						{
+							state.domains[c] &= ~(1u << p);
+							changed = true;
+						}
+					if (state.domains[c] == 0) return false;
+				}
+
+			// an unmapped letter with one choice left takes it away from every other letter in the message
+			for (int c = 0; c < 26; ++c)
+			{
+				std::uint32_t only = state.domains[c];
+				if (key[c] != '?' || message.uses[c].empty() || (only & (only - 1)) != 0) continue;
+				for (int d = 0; d < 26; ++d)
+				{
+					if (d == c || key[d] != '?' || message.uses[d].empty() || !(state.domains[d] & only)) continue;
+					state.domains[d] &= ~only;
+					if (state.domains[d] == 0) return false;	// two letters need the same plaintext letter
+					changed = true;
+				}
+			}
+		}
+		if (forced.empty()) return true;
+
+		// take the forced words, then start over to see what they tell us. they all have to hold at once,
+		// so if one of them doesn't fit the others this is a dead end
+		for (unsigned int i = 0; i < forced.size(); ++i)
+			if (state.unknown[forced[i].first] != 0 && !pushWord(state, forced[i].first, forced[i].second))
+				return false;
 	}
 }
 
-bool   DecrypterImpl::containsChar(const string& word, const char& character) const
+bool DecrypterImpl::pushWord(SearchState& state, unsigned int word, string_view candidate) const
 {
-	for (unsigned short i = 0; i < word.size(); ++i)
-		if (word[i] == character) return false;
+	const string& cipherWord = state.message.words[word];
+	string before = state.translator.getTranslation(cipherWord);	// which of its letters are unknown before the push
+	if (!state.translator.pushMapping(cipherWord, string(candidate))) return false;
+
+	// only the words sharing a letter this push mapped can have changed
+	size_t depth = state.frames.size();
+	state.frames.push_back(state.mappedLog.size());
+	state.frameWild.push_back(-1);
+	state.completed.clear();
+	for (unsigned int i = 0; i < cipherWord.size(); ++i)
+	{
+		if (before[i] != '?') continue;
+		int letter = toupper(static_cast<unsigned char>(cipherWord[i])) - 'A';
+		before[i] = '!';	// the same letter further along the word is not new any more
+		for (unsigned int j = i + 1; j < cipherWord.size(); ++j)
+			if (toupper(static_cast<unsigned char>(cipherWord[j])) - 'A' == letter) before[j] = '!';
+		state.mappedLog.push_back(letter);
+		const vector<CipherMessage::LetterUse>& uses = state.message.uses[letter];
+		for (unsigned int u = 0; u < uses.size(); ++u)
+		{
+			state.unknown[uses[u].word] -= uses[u].count;
+			if (!state.wild[uses[u].word]) state.unknownTotal -= uses[u].count;
+			if (state.unknown[uses[u].word] == 0)
+				state.completed.push_back(uses[u].word);
+		}
+	}
+
+	bool valid;
+	{
+		Stats::Timer timer(&CrackStats::validateTime);
+		valid = isValidSoFar(state);
+	}
+	if (!valid)	// if not valid, then pop the mapping (and any word it gave up on) and return false
+	{
+		Stats::count(&CrackStats::validationFailures);
+		popWordsTo(state, depth);
+		return false;
+	}
+	if (state.frames.size() > state.stats.maxDepth)
+		state.stats.maxDepth = static_cast<unsigned int>(state.frames.size());
 	return true;
 }
-bool   DecrypterImpl::isValidSoFar(const string& message) const
+
+void DecrypterImpl::popWord(SearchState& state) const
+{
+	unsigned int start = state.frames.back();
+	int wildWord = state.frameWild.back();
+	state.frames.pop_back();
+	state.frameWild.pop_back();
+	if (wildWord >= 0)	// a word we gave up on, not a mapping
+	{
+		state.wild[wildWord] = false;
+		state.unknownTotal += state.unknown[wildWord];
+		state.wildLeft++;
+		return;
+	}
+	while (state.mappedLog.size() > start)
+	{
+		const vector<CipherMessage::LetterUse>& uses = state.message.uses[static_cast<int>(state.mappedLog.back())];
+		for (unsigned int u = 0; u < uses.size(); ++u)
+		{
+			state.unknown[uses[u].word] += uses[u].count;
+			if (!state.wild[uses[u].word]) state.unknownTotal += uses[u].count;
+		}
+		state.mappedLog.pop_back();
+	}
+	state.translator.popMapping();
+}
+
+void DecrypterImpl::markWild(SearchState& state, unsigned int word) const
+{
+	state.frames.push_back(static_cast<unsigned int>(state.mappedLog.size()));
+	state.frameWild.push_back(static_cast<int>(word));
+	state.wild[word] = true;
+	state.unknownTotal -= state.unknown[word];
+	state.wildLeft--;
+}
+
+void DecrypterImpl::crackParallel(const CipherMessage& message, SearchLimits& limits, CrackStats& stats) const
+{
+	ParallelCrack job(message, limits, m_nThreads);
+	job.pool.submit([this, &job](unsigned int worker) { crackTask(job, worker, MappingPath()); });
+	job.pool.wait();
+	for (unsigned int i = 0; i < job.states.size(); ++i)
+		Stats::merge(stats, job.states[i]->stats);
+}
+
+void DecrypterImpl::crackTask(ParallelCrack& job, unsigned int worker, const MappingPath& path) const
+{
+	SearchState& state = *job.states[worker];
+	if (shouldStop(state)) return;	// a limit was hit while this task sat in the queue
+	Stats::Scope scope(&state.stats);
+
+	// replay the mappings that lead to this subtree. they were all accepted when the task was made, and
+	// propagate forces the same words every time it sees the same mapping
+	size_t depth = state.frames.size();
+	bool alive = !state.limits.propagate || propagate(state);	// only the root task can fail here
+	for (unsigned int i = 0; i < path.size(); ++i)
+	{
+		if (path[i].second.empty()) markWild(state, path[i].first);
+		else pushWord(state, path[i].first, path[i].second);
+		if (state.limits.propagate) propagate(state);
+	}
+
+	if (!alive)
+		;	// nothing to search
+	else if (isFullyTranslated(state))	// propagate filled in the whole message at the root
+		addResult(state);
+	else if (path.size() >= PARALLEL_SPLIT_DEPTH)	// deep enough: search the rest of the subtree right here
+		crackLevel(state);
+	else	// otherwise make one task per surviving candidate, just like crackHelper would recurse
+	{
+		unsigned int curr = getNextWord(state);
+		vector<string_view> candidates;
+		findCandidates(state, curr, candidates);
+		for (unsigned int i = 0; i <= candidates.size() && !shouldStop(state); ++i)
+		{
+			bool giveUp = (i == candidates.size());	// the branch where it's none of them, like crackLevel's
+			if (giveUp && state.wildLeft == 0) break;
+			state.stats.nodes++;
+			size_t childDepth = state.frames.size();
+			if (giveUp) markWild(state, curr);
+			else if (!pushWord(state, curr, candidates[i])) continue;
+			if (!state.limits.propagate || propagate(state))
+			{
+				if (isFullyTranslated(state))
+					addResult(state);
+				else
+				{
+					MappingPath childPath(path);
+					childPath.push_back(make_pair(curr, giveUp ? string_view() : candidates[i]));	// empty for giving up
+					job.pool.spawn(worker, [this, &job, childPath](unsigned int w) { crackTask(job, w, childPath); });
+				}
+			}
+			popWordsTo(state, childDepth);
+		}
+	}
+
+	popWordsTo(state, depth);
+}
+
+bool   DecrypterImpl::shouldStop(SearchState& state) const
 {
-	vector<string> separatedWords = m_tokenizer.tokenize(message);
-	for (unsigned int i = 0; i < separatedWords.size(); ++i)
+	SearchLimits& limits = state.limits;
+	if (limits.stopped.load(memory_order_relaxed)) return true;
+	if (limits.checksLimits() && ++state.nodesSinceCheck >= LIMIT_CHECK_INTERVAL)	// the clock is too slow to read every node
 	{
-		if (!containsChar(separatedWords[i], '?')) continue;		// if a word has any question marks, skip it
-		if (!m_wordList->contains(separatedWords[i]))	return false;	// if a complete word is not valid, return false
+		state.nodesSinceCheck = 0;
+		unsigned long long nodes = limits.nodes.fetch_add(LIMIT_CHECK_INTERVAL, memory_order_relaxed) + LIMIT_CHECK_INTERVAL;
+		if ((limits.maxNodes != 0 && nodes >= limits.maxNodes)
+			|| (limits.cancel && limits.cancel->load(memory_order_relaxed))
+			|| (limits.hasDeadline && chrono::steady_clock::now() >= limits.deadline))
+		{
+			limits.stopped = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+void   DecrypterImpl::addResult(SearchState& state) const
+{
+	SearchLimits& limits = state.limits;
+	if (state.wildLeft > 0) return;	// a search with fewer unknown words has this one
+	string plaintext = state.translator.getTranslation(state.message.text);
+	lock_guard<mutex> guard(limits.visitLock);
+	if (limits.stopped) return;	// another worker already ended the crack
+	limits.nResults++;
+	state.nResults++;
+	if (!limits.visit(plaintext) || (limits.maxResults != 0 && limits.nResults >= limits.maxResults))
+		limits.stopped = true;
+}
+
+bool   DecrypterImpl::isValidSoFar(SearchState& state) const
+{
+	// a word's translation can't change once all of its letters are mapped, so only the newly finished ones need a look
+	for (unsigned int i = 0; i < state.completed.size(); ++i)
+	{
+		unsigned int word = state.completed[i];
+		const string& cipherWord = state.message.words[word];
+		bool valid = m_wordList->contains(state.translator.getTranslation(cipherWord));
+		if (state.wild[word])
+		{
+			if (valid) return false;	// the branch that tried it as this word already has this solution
+		}
+		else if (!valid)	// if a complete word is not valid, give up on it if we still can, or else return false
+		{
+			if (state.wildLeft == 0) return false;
+			markWild(state, word);
+		}
 	}
 	return true;
 }
-string DecrypterImpl::getNextWord(const std::string& ciphertext) const
+
+unsigned int DecrypterImpl::getNextWord(const SearchState& state) const
 {
-	vector<string> untranslatedVec = m_tokenizer.tokenize(ciphertext);			// tokenize the untranslated vector
-	string encrypted = m_translator->getTranslation(ciphertext);	// translate the current string 
-	vector<string> translatedVec = m_tokenizer.tokenize(encrypted);	// tokenize the translated string
-	int posMostUnknown(0), mostUnknown(0);
-	for (unsigned int i = 0; i < translatedVec.size(); ++i)	// go through vector of words
+	unsigned int posMostUnknown(0), mostUnknown(0);
+	size_t fewest = 0;
+	for (unsigned int i = 0; i < state.unknown.size(); ++i)	// go through the words
 	{
-		int currUnknown(0);
-		for (unsigned int j = 0; j < translatedVec[i].size(); ++j)	// for each word, count the number of unknown characters
+		unsigned int currUnknown = state.unknown[i];
+		if (currUnknown == 0 || state.wild[i]) continue;	// nothing left to guess
+		if (state.limits.order == WordOrder::FewestCandidates)	// fail first: the word with the fewest ways to go
 		{
-			if (translatedVec[i][j] == '?')
-				currUnknown++;
+			size_t count;
+			if (state.limits.propagate)
+				count = state.candidateCounts[i];
+			else
+			{
+				const string& cipherWord = state.message.words[i];
+				count = m_wordList->countCandidates(cipherWord, state.translator.getTranslation(cipherWord));
+			}
+			if (mostUnknown == 0 || count < fewest)
+			{
+				posMostUnknown = i;
+				mostUnknown = currUnknown;
+				fewest = count;
+				continue;
+			}
+			if (count > fewest) continue;	// otherwise a tie, so fall through to the usual rule
 		}
 		if (currUnknown > mostUnknown)	// if a word has more unknown characters, hold onto its position
 		{
@@ -128,15 +1524,9 @@ string DecrypterImpl::getNextWord(const std::string& ciphertext) const
 			mostUnknown = currUnknown;
 		}
 		else if (currUnknown == mostUnknown)	// if both words have the same number of unknown characters, return the longer word
-			if (translatedVec[i].size() > translatedVec[posMostUnknown].size()) posMostUnknown = i;
+			if (state.message.words[i].size() > state.message.words[posMostUnknown].size()) posMostUnknown = i;
 	}
-	return untranslatedVec[posMostUnknown];
-}
-bool   DecrypterImpl::isFullyTranslated(const string& message) const
-{
-	for (unsigned int i = 0; i < message.size(); ++i)
-		if (message[i] == '?') return false;
-	return true;
+	return posMostUnknown;
 }
 
 //******************** Decrypter functions ************************************
@@ -159,7 +1549,52 @@ bool Decrypter::load(string filename)
     return m_impl->load(filename);
 }
 
+void Decrypter::setThreadCount(unsigned int nThreads)
+{
+    m_impl->setThreadCount(nThreads);
+}
+
+void Decrypter::setCacheSize(size_t maxEntries)
+{
+    m_impl->setCacheSize(maxEntries);
+}
+
+void Decrypter::setWordListBackend(WordListBackend backend)
+{
+    m_impl->setWordListBackend(backend);
+}
+
 vector<string> Decrypter::crack(const string& ciphertext)
 {
-   return m_impl->crack(ciphertext);
+   return m_impl->crack(ciphertext, CrackOptions()).solutions;
+}
+
+CrackResult Decrypter::crack(const string& ciphertext, const CrackOptions& options) const
+{
+   return m_impl->crack(ciphertext, options);
+}
+
+bool Decrypter::crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options) const
+{
+   return m_impl->crack(ciphertext, visit, options);
+}
+
+bool Decrypter::crack(const string& ciphertext, const SolutionVisitor& visit, const CrackOptions& options, CrackStats& stats) const
+{
+   return m_impl->crack(ciphertext, visit, options, stats);
+}
+
+AnnealResult Decrypter::crackAnneal(const string& ciphertext, const CrackOptions& options) const
+{
+   return m_impl->crackAnneal(ciphertext, options);
+}
+
+BestCrackResult Decrypter::crackBest(const string& ciphertext, size_t k, const CrackOptions& options) const
+{
+   return m_impl->crackBest(ciphertext, k, options);
+}
+
+SharedKeyResult Decrypter::crackShared(const vector<string>& ciphertexts, const CrackOptions& options) const
+{
+   return m_impl->crackShared(ciphertexts, options);
 }
\ No newline at end of file
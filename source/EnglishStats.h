@@ -0,0 +1,112 @@
+#ifndef ENGLISH_STATS_H
+#define ENGLISH_STATS_H
+
+#include <cmath>
+
+/////////////////////////////////////////////////////////////
+// EnglishStats Interface
+/////////////////////////////////////////////////////////////
+
+// A letter model of English words: how likely each letter is to start a word, and how likely each
+// letter is to follow another. Everything is a log10 probability, so scores of longer texts add up
+// and higher (closer to 0) means more English looking. Letters are 0 for 'a' through 25 for 'z'.
+//
+// A word scores first(l1) + next(l1, l2) + ... + next(ln-1, ln), which is the same as
+// letter(l1) + ... + letter(ln) + lift(l1, l2) + ... + lift(ln-1, ln). Searches use the second
+// form, since the letter part can be bounded well from letter counts alone.
+class EnglishStats
+{
+public:
+	static const EnglishStats& get()	// the tables are the same for everyone, so build them once
+	{
+		static const EnglishStats stats;
+		return stats;
+	}
+
+	double first(int a) const { return m_first[a]; }			// log10 P(a word starts with a)
+	double next(int a, int b) const { return m_next[a][b]; }	// log10 P(b follows a)
+	double letter(int a) const { return m_first[a]; }			// log10 P(a), words start like any other letter
+	double lift(int a, int b) const { return m_lift[a][b]; }	// log10 P(b follows a) / P(b)
+
+	// upper bounds for when some letters aren't known yet
+	double maxLift() const { return m_maxLift; }
+	double maxLiftFrom(int a) const { return m_maxLiftFrom[a]; }	// best letter to follow a
+	double maxLiftTo(int b) const { return m_maxLiftTo[b]; }		// best letter to precede b
+
+	// C++11 syntax for preventing copying and assignment
+	EnglishStats(const EnglishStats&) = delete;
+	EnglishStats& operator=(const EnglishStats&) = delete;
+
+private:
+	double m_first[26];
+	double m_next[26][26];
+	double m_lift[26][26];
+	double m_maxLift;
+	double m_maxLiftFrom[26];
+	double m_maxLiftTo[26];
+
+	EnglishStats()
+	{
+		// percent of letters in running english text
+		static const double letterPercent[26] = {
+			8.167, 1.492, 2.782, 4.253, 12.702, 2.228, 2.015, 6.094, 6.966, 0.153, 0.772, 4.025, 2.406,
+			6.749, 7.507, 1.929, 0.095, 5.987, 6.327, 9.056, 2.758, 0.978, 2.360, 0.150, 1.974, 0.074 };
+		// percent of letter pairs in running english text, for the most common pairs
+		static const struct { char pair[3]; double percent; } bigramPercent[] = {
+			{ "th", 3.56 }, { "he", 3.07 }, { "in", 2.43 }, { "er", 2.05 }, { "an", 1.99 }, { "re", 1.85 },
+			{ "on", 1.76 }, { "at", 1.49 }, { "en", 1.45 }, { "nd", 1.35 }, { "ti", 1.34 }, { "es", 1.34 },
+			{ "or", 1.28 }, { "te", 1.20 }, { "of", 1.17 }, { "ed", 1.17 }, { "is", 1.13 }, { "it", 1.12 },
+			{ "al", 1.09 }, { "ar", 1.07 }, { "st", 1.05 }, { "to", 1.04 }, { "nt", 1.04 }, { "ng", 0.95 },
+			{ "se", 0.93 }, { "ha", 0.93 }, { "as", 0.87 }, { "ou", 0.87 }, { "io", 0.83 }, { "le", 0.83 },
+			{ "ve", 0.83 }, { "co", 0.79 }, { "me", 0.79 }, { "de", 0.76 }, { "hi", 0.76 }, { "ri", 0.73 },
+			{ "ro", 0.73 }, { "ic", 0.70 }, { "ne", 0.69 }, { "ea", 0.69 }, { "ra", 0.69 }, { "ce", 0.65 },
+			{ "li", 0.62 }, { "ch", 0.60 }, { "ll", 0.58 }, { "be", 0.58 }, { "ma", 0.57 }, { "si", 0.55 },
+			{ "om", 0.55 }, { "ur", 0.54 } };
+		const int nBigrams = sizeof(bigramPercent) / sizeof(bigramPercent[0]);
+
+		// pairs we have no number for share what's left, as if their letters were independent
+		bool known[26][26] = { { false } };
+		double joint[26][26];
+		double knownMass = 0, unknownWeight = 0;
+		for (int i = 0; i < nBigrams; ++i)
+		{
+			int a = bigramPercent[i].pair[0] - 'a', b = bigramPercent[i].pair[1] - 'a';
+			joint[a][b] = bigramPercent[i].percent;
+			known[a][b] = true;
+			knownMass += bigramPercent[i].percent;
+		}
+		for (int a = 0; a < 26; ++a)
+			for (int b = 0; b < 26; ++b)
+				if (!known[a][b]) unknownWeight += letterPercent[a] * letterPercent[b];
+		for (int a = 0; a < 26; ++a)
+			for (int b = 0; b < 26; ++b)
+				if (!known[a][b]) joint[a][b] = (100 - knownMass) * letterPercent[a] * letterPercent[b] / unknownWeight;
+
+		// turn the pair table into P(b follows a) and take logs
+		for (int a = 0; a < 26; ++a)
+			m_first[a] = std::log10(letterPercent[a] / 100);
+		m_maxLift = -1e9;
+		for (int a = 0; a < 26; ++a)
+		{
+			double rowTotal = 0;
+			for (int b = 0; b < 26; ++b)
+				rowTotal += joint[a][b];
+			m_maxLiftFrom[a] = -1e9;
+			for (int b = 0; b < 26; ++b)
+			{
+				m_next[a][b] = std::log10(joint[a][b] / rowTotal);
+				m_lift[a][b] = m_next[a][b] - m_first[b];
+				if (m_lift[a][b] > m_maxLiftFrom[a]) m_maxLiftFrom[a] = m_lift[a][b];
+			}
+			if (m_maxLiftFrom[a] > m_maxLift) m_maxLift = m_maxLiftFrom[a];
+		}
+		for (int b = 0; b < 26; ++b)
+		{
+			m_maxLiftTo[b] = -1e9;
+			for (int a = 0; a < 26; ++a)
+				if (m_lift[a][b] > m_maxLiftTo[b]) m_maxLiftTo[b] = m_lift[a][b];
+		}
+	}
+};
+
+#endif // ENGLISH_STATS_H
@@ -1,26 +1,38 @@
 #ifndef MY_HASH_H
 #define MY_HASH_H
 
+#include <cstdint>
 #include <functional>
+#include <new>
 #include <string>
+#include <utility>
+#include <vector>
 
 /////////////////////////////////////////////////////////////
 // MyHash Interface
 /////////////////////////////////////////////////////////////
 
-template<typename KeyType, typename ValueType>
+// An open addressing hash map using Robin Hood probing over a power of two
+// slot array. Slots are small (an entry index plus probe distance and a hash
+// tag), so probing stays in cache; the key/value pairs themselves live in an
+// arena of fixed size blocks, which means a rehash only rebuilds the slots
+// and pointers returned by find() stay valid until reset() or remove().
+template<typename KeyType, typename ValueType, typename Hasher = std::hash<KeyType>>
 class MyHash
 {
 public:
 	MyHash(double maxLoadFactor = 0.5)
-		:m_maxLoad(maxLoadFactor), m_size(0), m_head(nullptr), m_tail(nullptr)
+		:m_maxLoad(maxLoadFactor), m_size(0), m_nSlots(0), m_slots(nullptr)
 	{
-		if (m_maxLoad > 2.0) m_maxLoad = 2.0;
+		if (m_maxLoad > 0.9) m_maxLoad = 0.9;	// open addressing needs some empty slots
+		if (m_maxLoad < 0.1) m_maxLoad = 0.1;
 		init();
 	}
 	~MyHash();
 	void reset();
+	void reserve(unsigned long nItems);	// make room for nItems without rehashing
 	void associate(const KeyType& key, const ValueType& value);
+	bool remove(const KeyType& key);	// false if the key isn't there
 	int getNumItems() const;
 	double getLoadFactor() const;
 
@@ -40,202 +52,257 @@ public:
 private:
 
 	/////////////////////////////////////////////////////////////
-	// Private Node Implementation
+	// Private Entry and Slot Implementation
 	/////////////////////////////////////////////////////////////
 
-	struct Node {
-		Node(const KeyType& key_, const ValueType& val_)
-			:next(nullptr), nextIter(nullptr), key(key_), val(val_)
+	struct Entry {
+		Entry(const KeyType& key_, const ValueType& val_, std::uint64_t hash_)
+			:key(key_), val(val_), hash(hash_)
 		{}
 
-		KeyType   key;
-		ValueType val;
-		Node*     next;		// used for each bucket
-		Node*     nextIter;	// used for a list between all nodes
+		KeyType       key;
+		ValueType     val;
+		std::uint64_t hash;		// kept so a rehash never has to hash the key again
 	};
 
+	struct Slot {
+		std::uint32_t entry;	// index of the entry in the arena
+		std::uint16_t dist;		// 1 + how far the slot is from the entry's home slot, 0 if empty
+		std::uint16_t tag;		// a few more bits of the hash, checked before touching the entry
+	};
+
+	static const unsigned long ENTRIES_PER_BLOCK = 256;
+	static const unsigned long MIN_SLOTS = 16;
+
 	/////////////////////////////////////////////////////////////
 	// Private data members
 	/////////////////////////////////////////////////////////////
 
-	unsigned long m_nBuckets;
-	unsigned long m_size;
-	double        m_maxLoad;
-	Node*         m_head;
-	Node*         m_tail;
-	Node**        m_bucketArray;
+	double              m_maxLoad;
+	unsigned long       m_size;
+	unsigned long       m_nSlots;		// always a power of two
+	int                 m_shift;		// 64 - log2(m_nSlots), for picking a home slot
+	Slot*               m_slots;
+	std::vector<Entry*> m_blocks;		// the arena: blocks of ENTRIES_PER_BLOCK entries
 
 	/////////////////////////////////////////////////////////////
 	// Private member functions
 	/////////////////////////////////////////////////////////////
 
-	// returns a bucket number for a given key
-	unsigned int  getBktNum(const KeyType& key) const
+	// returns the full 64 bit hash of a key, mixed so the top bits are usable even for weak hashes
+	std::uint64_t getHash(const KeyType& key) const
+	{
+		Hasher keyHash;
+		std::uint64_t h = static_cast<std::uint64_t>(keyHash(key));
+		return h * 0x9E3779B97F4A7C15ull;	// fibonacci hashing
+	}
+	unsigned long getHomeSlot(std::uint64_t hash) const
+	{
+		return static_cast<unsigned long>(hash >> m_shift);
+	}
+	static std::uint16_t getTag(std::uint64_t hash)
+	{
+		return static_cast<std::uint16_t>(hash);
+	}
+	Entry* getEntry(std::uint32_t index) const
 	{
-		std::hash<KeyType> keyHash;
-		unsigned int num = keyHash(key);
-		return num % m_nBuckets;
+		return m_blocks[index / ENTRIES_PER_BLOCK] + index % ENTRIES_PER_BLOCK;
 	}
-	// pass in an existing node and add it to the hash map
-	void addExistingNode(Node* ptr)
+	// construct a new entry at the end of the arena and return its index
+	std::uint32_t addEntry(const KeyType& key, const ValueType& value, std::uint64_t hash)
 	{
-		int pos = getBktNum(ptr->key);
-		Node* last = m_bucketArray[pos];
-		if (!last)	// if bucket is initially empty
-			m_bucketArray[pos] = ptr;	// bucket points to node
-		else
+		if (m_size == m_blocks.size() * ENTRIES_PER_BLOCK)	// last block is full (or there are none)
+			m_blocks.push_back(static_cast<Entry*>(::operator new(sizeof(Entry) * ENTRIES_PER_BLOCK)));
+		new (getEntry(m_size)) Entry(key, value, hash);
+		return static_cast<std::uint32_t>(m_size++);
+	}
+	// robin hood insertion of a slot: whoever is further from home keeps the spot
+	void placeSlot(Slot slot, unsigned long pos)
+	{
+		unsigned long mask = m_nSlots - 1;
+		for (;;)
 		{
-			while (last->next != nullptr)	// move last to the last node of a bucket
-				last = last->next;
-			last->next = ptr;	// add the new node to the end of the list
+			if (m_slots[pos].dist == 0)	// empty slot, done
+			{
+				m_slots[pos] = slot;
+				return;
+			}
+			if (m_slots[pos].dist < slot.dist)	// the resident is richer than us, so it moves on instead
+				std::swap(m_slots[pos], slot);
+			pos = (pos + 1) & mask;
+			slot.dist++;
 		}
-		ptr->next = nullptr;
 	}
-	// doubles the current bucket size and reallocates memory for it.
-	void changeBucketSize()
+	// returns the slot of key's entry, m_nSlots if it isn't there
+	unsigned long findKey(const KeyType& key) const
 	{
-		m_nBuckets *= 2;
-		delete[] m_bucketArray;
-		m_bucketArray = new Node*[m_nBuckets];
-		// initialize the new array 
-		for (unsigned int i = 0; i < m_nBuckets; ++i)
-			m_bucketArray[i] = nullptr;
-
-		// add values to the new array
-		Node* temp = m_head;
-		while (temp)	// loop through the hash tables list of all nodes
+		std::uint64_t hash = getHash(key);
+		std::uint16_t tag = getTag(hash);
+		unsigned long mask = m_nSlots - 1;
+		unsigned long pos = getHomeSlot(hash);
+		for (std::uint16_t dist = 1; ; ++dist)
 		{
-			addExistingNode(temp);
-			temp = temp->nextIter;
+			const Slot& slot = m_slots[pos];
+			// robin hood keeps each run sorted by distance, so a closer slot means our key isn't here
+			if (slot.dist < dist)
+				return m_nSlots;
+			if (slot.tag == tag)
+			{
+				Entry* entry = getEntry(slot.entry);
+				if (entry->hash == hash && entry->key == key)
+					return pos;
+			}
+			pos = (pos + 1) & mask;
 		}
-		//cout << m_nBuckets << '\t' << m_size << '\t' << getNumItems() << endl;
 	}
-	// returns true if needs to increase number of buckets
-	bool shouldIncreaseSize() const
+	// returns the slot of the entry with this index and hash, which has to be in the map
+	unsigned long findSlot(std::uint32_t entry, std::uint64_t hash) const
 	{
-		if (getLoadFactor() > m_maxLoad)
-			return true;
-		else return false;
+		unsigned long pos = getHomeSlot(hash);
+		while (m_slots[pos].entry != entry || m_slots[pos].dist == 0)
+			pos = (pos + 1) & (m_nSlots - 1);
+		return pos;
 	}
-	// clears all allocated memory 
-	void clearMem()
+	// allocates nSlots empty slots and re-adds every entry to them
+	void changeSlotCount(unsigned long nSlots)
 	{
-		Node* temp = m_head;
-		while (m_head)		// delete every node
+		delete[] m_slots;
+		m_nSlots = nSlots;
+		m_shift = 64;
+		for (unsigned long n = nSlots; n > 1; n >>= 1)
+			m_shift--;
+		m_slots = new Slot[m_nSlots];
+		for (unsigned long i = 0; i < m_nSlots; ++i)
+			m_slots[i].dist = 0;
+
+		for (unsigned long i = 0; i < m_size; ++i)	// entries don't move, only the slots pointing at them
 		{
-			temp = m_head->nextIter;
-			delete m_head;
-			m_head = temp;
+			std::uint64_t hash = getEntry(static_cast<std::uint32_t>(i))->hash;
+			Slot slot = { static_cast<std::uint32_t>(i), 1, getTag(hash) };
+			placeSlot(slot, getHomeSlot(hash));
 		}
-		delete[] m_bucketArray;	// delete the dynamic array
-		m_bucketArray = nullptr;
+	}
+	// returns the smallest power of two slot count that holds nItems under the max load
+	unsigned long slotsFor(unsigned long nItems) const
+	{
+		unsigned long nSlots = MIN_SLOTS;
+		while (static_cast<double>(nItems) > m_maxLoad * static_cast<double>(nSlots))
+			nSlots *= 2;
+		return nSlots;
+	}
+	// clears all allocated memory
+	void clearMem()
+	{
+		for (unsigned long i = 0; i < m_size; ++i)
+			getEntry(static_cast<std::uint32_t>(i))->~Entry();
+		for (unsigned long i = 0; i < m_blocks.size(); ++i)
+			::operator delete(m_blocks[i]);
+		m_blocks.clear();
+		delete[] m_slots;	// delete the dynamic array
+		m_slots = nullptr;
 		m_size = 0;
 	}
-	// resets bucket size to 100
+	// resets the slot array to its smallest size
 	void init()
 	{
-		m_nBuckets = 100;		// create a new dynamic array of node pointers
-		m_bucketArray = new Node*[m_nBuckets];
-		m_head = nullptr;
-		m_tail = nullptr;
-		for (unsigned int i = 0; i < m_nBuckets; ++i)
-			m_bucketArray[i] = nullptr;
+		changeSlotCount(MIN_SLOTS);
 	}
 
 };
 
 //////////////////////////////////////////////////////////////////
-// Public Member Function ImplementationsB) t
+// Public Member Function Implementations
 /////////////////////////////////////////////////////////////////
 
-	template <class KeyType, class ValueType>
-	MyHash<KeyType, ValueType>::~MyHash()	// delete the dynamic array and all the nodes
-	{
-		clearMem();
-	}
+template <class KeyType, class ValueType, class Hasher>
+MyHash<KeyType, ValueType, Hasher>::~MyHash()	// destroy every entry and free the arena and slots
+{
+	clearMem();
+}
 
-	template <class KeyType, class ValueType>
-	void MyHash<KeyType, ValueType>::reset()
-	{
-		clearMem();
-		init();
-	}
+template <class KeyType, class ValueType, class Hasher>
+void MyHash<KeyType, ValueType, Hasher>::reset()
+{
+	clearMem();
+	init();
+}
 
-template <class KeyType, class ValueType>
-void MyHash<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
+template <class KeyType, class ValueType, class Hasher>
+void MyHash<KeyType, ValueType, Hasher>::reserve(unsigned long nItems)
 {
-	int pos = getBktNum(key);		// find the appropriate bucket for the key
-	Node* addMe = new Node(key, value);
-	// first add the new node to its bucket
-	if (!m_bucketArray[pos])	// if that bucket hasn't been filled yet
-	{
-		m_bucketArray[pos] = addMe;
-		m_size++;
-	}
-	else	// if the bucket has other items in it
-	{
-		Node* curr = m_bucketArray[pos];	// last starts at wherever the bucket points
-		if (!curr)	// if the bucket is emtpy, make it point to the new node
-			m_bucketArray[pos] = addMe;
-		else
-		{
-			while (curr->next != nullptr)	// go to the last slot of the bucket list
-			{
-				if (curr->key == key) break;	// if the key already exists, break out of the loop to update
-				curr = curr->next;	// keeping moving through the node
-			}
-			if (curr->key == key)	// if the key/value pair already exists, update it and then return
-			{
-				curr->val = value;	// update
-				delete addMe;		// delete the extra node we allocated earlier
-				return;
-			}
-			curr->next = addMe;		// add the new node to the end of the list
-		}
-		m_size++;	// once we've added, increment the size
-	}
+	unsigned long nSlots = slotsFor(nItems);
+	if (nSlots > m_nSlots)
+		changeSlotCount(nSlots);
+	m_blocks.reserve((nItems + ENTRIES_PER_BLOCK - 1) / ENTRIES_PER_BLOCK);
+}
 
-	// then add the node to the iterator list
-	if (!m_head)	// if this is the first node we add ever
-	{
-		m_head = addMe;	// head and tail point to the new node
-		m_tail = addMe;
-		m_head->nextIter = nullptr;	// set up the list for iterating through nodes
-	}
-	else		// if this is not the first node we add
+template <class KeyType, class ValueType, class Hasher>
+void MyHash<KeyType, ValueType, Hasher>::associate(const KeyType& key, const ValueType& value)
+{
+	ValueType* existing = find(key);
+	if (existing)	// if the key/value pair already exists, update it and then return
 	{
-		m_tail->nextIter = addMe;	// add it to the back of the list
-		m_tail = addMe;				// move tail to the back
+		*existing = value;
+		return;
 	}
-	if (shouldIncreaseSize())	// if the size is too big after adding, then change bucket size
-		changeBucketSize();
+	if (static_cast<double>(m_size + 1) > m_maxLoad * static_cast<double>(m_nSlots))	// grow before adding
+		changeSlotCount(m_nSlots * 2);
+
+	std::uint64_t hash = getHash(key);
+	Slot slot = { addEntry(key, value, hash), 1, getTag(hash) };
+	placeSlot(slot, getHomeSlot(hash));
 }
 
-	template <class KeyType, class ValueType>
-	int MyHash<KeyType, ValueType>::getNumItems() const
+template <class KeyType, class ValueType, class Hasher>
+bool MyHash<KeyType, ValueType, Hasher>::remove(const KeyType& key)
+{
+	unsigned long pos = findKey(key);
+	if (pos == m_nSlots) return false;
+	std::uint32_t index = m_slots[pos].entry;
+	unsigned long mask = m_nSlots - 1;
+
+	// backward shift: everything after it in the run moves one slot closer to home, so no tombstones
+	for (unsigned long next = (pos + 1) & mask; m_slots[next].dist > 1; pos = next, next = (next + 1) & mask)
 	{
-		return m_size;
+		m_slots[pos] = m_slots[next];
+		m_slots[pos].dist--;
 	}
+	m_slots[pos].dist = 0;
 
-	template <class KeyType, class ValueType>
-	double MyHash<KeyType, ValueType>::getLoadFactor()	const
+	// keep the arena packed by moving the last entry into the hole
+	std::uint32_t last = static_cast<std::uint32_t>(m_size - 1);
+	Entry* hole = getEntry(index);
+	if (index != last)
 	{
-		return static_cast<double>(m_size) / static_cast<double>(m_nBuckets);
+		Entry* moved = getEntry(last);
+		m_slots[findSlot(last, moved->hash)].entry = index;
+		*hole = std::move(*moved);
+		hole = moved;
 	}
-	
-	template <class KeyType, class ValueType>
-	const ValueType* MyHash<KeyType, ValueType>::find(const KeyType& key)	const
-	{
-		int pos = getBktNum(key);
-		Node* curr = m_bucketArray[pos];	// go to the slot the key should be in
-		while (curr)	// search through the bucket for the key
-		{
-			if (curr->key == key)		// if we find the key, return the value's address
-				return &(curr->val);
-			curr = curr->next;	// otherwise continue searching
-		}
-		// if we didn't find it, return NULL
+	hole->~Entry();
+	m_size--;
+	return true;
+}
+
+template <class KeyType, class ValueType, class Hasher>
+int MyHash<KeyType, ValueType, Hasher>::getNumItems() const
+{
+	return m_size;
+}
+
+template <class KeyType, class ValueType, class Hasher>
+double MyHash<KeyType, ValueType, Hasher>::getLoadFactor() const
+{
+	return static_cast<double>(m_size) / static_cast<double>(m_nSlots);
+}
+
+template <class KeyType, class ValueType, class Hasher>
+const ValueType* MyHash<KeyType, ValueType, Hasher>::find(const KeyType& key) const
+{
+	unsigned long pos = findKey(key);
+	if (pos == m_nSlots)
 		return nullptr;
-	}
+	return &(getEntry(m_slots[pos].entry)->val);	// if we find the key, return the value's address
+}
 
-#endif  
+#endif // MY_HASH_H
@@ -0,0 +1,315 @@
+#include "provided.h"
+#include "WorkStealingPool.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <map>
+#include <atomic>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// The protocol is one line per request and one line per response, so it works the same over a pipe
+// and over a socket:
+//
+//   request:   <id> TAB <ciphertext>          (without a TAB the whole line is the ciphertext, and
+//                                             the id is the line's number, counting from 1)
+//   responses: <id> TAB solution TAB <plaintext>     once per solution, sorted
+//              <id> TAB done TAB <count>             the crack finished
+//              <id> TAB truncated TAB <count>        the timeout or result cap cut it short
+//
+// Requests are cracked concurrently, so the responses of different requests come back in whatever
+// order the cracks finish, but the lines of one request are always written together. serveOrdered()
+// holds finished answers back until everything before them is written, so they come out in order.
+
+// how many requests may wait for a thread, per thread, before we stop reading new ones
+const unsigned int REQUESTS_QUEUED_PER_THREAD = 4;
+
+class DecryptServerImpl
+{
+public:
+	DecryptServerImpl(const Decrypter& decrypter, unsigned int nThreads, const CrackOptions& options);
+	bool serve(istream& in, ostream& out, bool ordered);	// serve requests from in until it runs out
+	bool serveSocket(const string& path);	// serve every connection to a unix socket
+private:
+	// where the responses of one stream of requests go
+	struct Connection {
+		Connection(function<bool(const string&)> write_, bool ordered_ = false)
+			:write(write_), ordered(ordered_), cancelled(false), pending(0), nSubmitted(0), nWritten(0) {}
+		function<bool(const string&)> write;	// send a block of lines, false if the other end is gone
+		bool                          ordered;	// answer in the order the requests came in
+		atomic<bool>                  cancelled;	// a write failed, so the cracks still running for it can stop
+		mutex                         lock;		// one writer at a time, and guards everything below
+		condition_variable            idle;
+		unsigned int                  pending;	// requests submitted but not written yet
+		unsigned long                 nSubmitted;
+		unsigned long                 nWritten;
+		map<unsigned long, string>    held;		// ordered: answers waiting for an earlier one, by request number
+	};
+
+	const Decrypter&   m_decrypter;
+	CrackOptions       m_options;
+	WorkStealingPool   m_pool;
+	mutex              m_slotLock;
+	condition_variable m_slotFree;
+	unsigned int       m_inFlight;		// requests queued or running, across every connection
+	unsigned int       m_maxInFlight;
+
+	void submit(const shared_ptr<Connection>& conn, const string& line, unsigned long lineNumber);
+	unsigned int answer(Connection& conn, unsigned long request, const string& id, const string& ciphertext) const;	// returns how many answers it wrote
+	void waitIdle(Connection& conn) const;
+};
+
+DecryptServerImpl::DecryptServerImpl(const Decrypter& decrypter, unsigned int nThreads, const CrackOptions& options)
+	:m_decrypter(decrypter), m_options(options), m_pool(nThreads == 0 ? thread::hardware_concurrency() : nThreads), m_inFlight(0)
+{
+	m_maxInFlight = m_pool.size() * REQUESTS_QUEUED_PER_THREAD;
+}
+
+bool DecryptServerImpl::serve(istream& in, ostream& out, bool ordered)
+{
+	shared_ptr<Connection> conn = make_shared<Connection>([&out](const string& lines) {
+		out << lines << flush;
+		return static_cast<bool>(out);
+	}, ordered);
+	string line;
+	unsigned long lineNumber = 0;
+	while (getline(in, line))
+		submit(conn, line, ++lineNumber);
+	waitIdle(*conn);
+	return true;
+}
+
+void DecryptServerImpl::submit(const shared_ptr<Connection>& conn, const string& line, unsigned long lineNumber)
+{
+	string request(line);
+	if (!request.empty() && request[request.size() - 1] == '\r')	// tolerate clients that send CRLF
+		request.erase(request.size() - 1);
+	if (request.empty()) return;
+
+	string id, ciphertext;
+	size_t tab = request.find('\t');
+	if (tab == string::npos)
+	{
+		id = to_string(lineNumber);
+		ciphertext = request;
+	}
+	else
+	{
+		id = request.substr(0, tab);
+		ciphertext = request.substr(tab + 1);
+	}
+
+	{
+		// don't read further ahead than the threads can keep up with
+		unique_lock<mutex> guard(m_slotLock);
+		m_slotFree.wait(guard, [this] { return m_inFlight < m_maxInFlight; });
+		m_inFlight++;
+	}
+	unsigned long requestNumber;
+	{
+		lock_guard<mutex> guard(conn->lock);
+		conn->pending++;
+		requestNumber = conn->nSubmitted++;
+	}
+	m_pool.submit([this, conn, requestNumber, id, ciphertext](unsigned int) {
+		// a held answer keeps its slot until it's written, so a slow request can't make us buffer without limit
+		unsigned int written = answer(*conn, requestNumber, id, ciphertext);
+		if (written == 0) return;
+		{
+			lock_guard<mutex> guard(conn->lock);
+			conn->pending -= written;
+			if (conn->pending == 0)
+				conn->idle.notify_all();
+		}
+		{
+			lock_guard<mutex> guard(m_slotLock);
+			m_inFlight -= written;
+		}
+		m_slotFree.notify_all();
+	});
+}
+
+unsigned int DecryptServerImpl::answer(Connection& conn, unsigned long request, const string& id, const string& ciphertext) const
+{
+	CrackOptions options(m_options);
+	options.cancel = &conn.cancelled;	// nobody is left to read the answer
+	CrackResult result = m_decrypter.crack(ciphertext, options);
+	string lines;
+	for (unsigned int i = 0; i < result.solutions.size(); ++i)
+		lines += id + "\tsolution\t" + result.solutions[i] + "\n";
+	lines += id + (result.truncated ? "\ttruncated\t" : "\tdone\t") + to_string(result.solutions.size()) + "\n";
+
+	lock_guard<mutex> guard(conn.lock);
+	if (!conn.ordered)
+	{
+		if (!conn.write(lines)) conn.cancelled = true;
+		conn.nWritten++;
+		return 1;
+	}
+	if (request != conn.nWritten)	// something before us isn't done, whoever finishes it writes us too
+	{
+		conn.held[request] = lines;
+		return 0;
+	}
+	unsigned int written = 0;
+	for (;;)	// write ours, then any held answers that were only waiting for it
+	{
+		if (!conn.write(lines)) conn.cancelled = true;
+		written++;
+		map<unsigned long, string>::iterator next = conn.held.find(request + written);
+		if (next == conn.held.end()) break;
+		lines.swap(next->second);
+		conn.held.erase(next);
+	}
+	conn.nWritten += written;
+	return written;
+}
+
+void DecryptServerImpl::waitIdle(Connection& conn) const
+{
+	unique_lock<mutex> guard(conn.lock);
+	conn.idle.wait(guard, [&conn] { return conn.pending == 0; });
+}
+
+#ifndef _WIN32
+
+// writes all of lines to a socket, false if the peer went away
+static bool sendAll(int fd, const string& lines)
+{
+	size_t sent = 0;
+	while (sent < lines.size())
+	{
+		ssize_t n = send(fd, lines.data() + sent, lines.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) return false;
+		sent += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool DecryptServerImpl::serveSocket(const string& path)
+{
+	sockaddr_un address;
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		cerr << "Socket path too long: " << path << endl;
+		return false;
+	}
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) return false;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path.c_str());
+	unlink(path.c_str());	// a socket left behind by an earlier run
+	if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+	{
+		cerr << "Unable to listen on " << path << ": " << strerror(errno) << endl;
+		close(listener);
+		return false;
+	}
+
+	// each connection gets a reader thread that feeds its requests to the pool
+	vector<int>        clients;		// sockets with a live reader
+	mutex              clientsLock;
+	condition_variable readerDone;
+	for (;;)
+	{
+		int fd = accept(listener, nullptr, nullptr);
+		if (fd < 0)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+		{
+			lock_guard<mutex> guard(clientsLock);
+			clients.push_back(fd);
+		}
+		thread([this, fd, &clients, &clientsLock, &readerDone]() {
+			shared_ptr<Connection> conn = make_shared<Connection>([fd](const string& lines) { return sendAll(fd, lines); });
+			string pending;
+			unsigned long lineNumber = 0;
+			char buffer[4096];
+			ssize_t n;
+			while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+			{
+				pending.append(buffer, static_cast<size_t>(n));
+				size_t start = 0, newline;
+				while ((newline = pending.find('\n', start)) != string::npos)
+				{
+					submit(conn, pending.substr(start, newline - start), ++lineNumber);
+					start = newline + 1;
+				}
+				pending.erase(0, start);
+			}
+			if (!pending.empty())	// a last request without a newline
+				submit(conn, pending, ++lineNumber);
+			waitIdle(*conn);	// answer everything before hanging up
+			lock_guard<mutex> guard(clientsLock);
+			clients.erase(find(clients.begin(), clients.end(), fd));
+			close(fd);
+			readerDone.notify_all();
+		}).detach();
+	}
+
+	// accept() failed for good: hang up on everyone and wait for the readers to notice
+	cerr << "Stopped accepting connections on " << path << ": " << strerror(errno) << endl;
+	{
+		unique_lock<mutex> guard(clientsLock);
+		for (unsigned int i = 0; i < clients.size(); ++i)
+			shutdown(clients[i], SHUT_RDWR);
+		readerDone.wait(guard, [&clients] { return clients.empty(); });
+	}
+	close(listener);
+	unlink(path.c_str());
+	return false;
+}
+
+#else
+
+bool DecryptServerImpl::serveSocket(const string& path)
+{
+	cerr << "Unix sockets are not supported on this platform, serve on stdin instead" << endl;
+	return false;
+}
+
+#endif
+
+//******************** DecryptServer functions ************************************
+
+// These functions simply delegate to DecryptServerImpl's functions.
+
+DecryptServer::DecryptServer(const Decrypter& decrypter, unsigned int nThreads, const CrackOptions& options)
+{
+    m_impl = new DecryptServerImpl(decrypter, nThreads, options);
+}
+
+DecryptServer::~DecryptServer()
+{
+    delete m_impl;
+}
+
+bool DecryptServer::serve(istream& in, ostream& out)
+{
+    return m_impl->serve(in, out, false);
+}
+
+bool DecryptServer::serveOrdered(istream& in, ostream& out)
+{
+    return m_impl->serve(in, out, true);
+}
+
+bool DecryptServer::serveSocket(const string& path)
+{
+    return m_impl->serveSocket(path);
+}
@@ -0,0 +1,93 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "provided.h"
+#include <chrono>
+
+/////////////////////////////////////////////////////////////
+// Stats Interface
+/////////////////////////////////////////////////////////////
+
+// Where the DecrypterImpl, WordListImpl and TranslatorImpl counters go. A crack points each of its
+// threads at a CrackStats with a Stats::Scope, and the code it calls counts into whatever the
+// calling thread points at (nothing, outside of a crack).
+//
+// Everything except CrackStats::nodes, maxDepth and the transposition counters, which the search
+// keeps itself, is only counted when built with CRACKER_STATS defined. Otherwise ENABLED is false
+// and every call below is an empty inline function, so the counters cost nothing.
+class Stats
+{
+public:
+#ifdef CRACKER_STATS
+	static const bool ENABLED = true;
+#else
+	static const bool ENABLED = false;
+#endif
+
+	typedef unsigned long long CrackStats::*Counter;
+	typedef std::chrono::nanoseconds CrackStats::*Clock;
+
+	// counts into stats on this thread for as long as it's around
+	class Scope
+	{
+	public:
+		Scope(CrackStats* stats) :m_previous(ENABLED ? sink() : nullptr) { if (ENABLED) sink() = stats; }
+		~Scope() { if (ENABLED) sink() = m_previous; }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		CrackStats* m_previous;
+	};
+
+	// adds the time from its construction to its destruction to a clock
+	class Timer
+	{
+	public:
+		Timer(Clock clock) :m_stats(ENABLED ? sink() : nullptr), m_clock(clock)
+		{
+			if (m_stats) m_start = std::chrono::steady_clock::now();
+		}
+		~Timer()
+		{
+			if (m_stats) m_stats->*m_clock += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+		}
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	private:
+		CrackStats*                           m_stats;	// nullptr if we aren't timing
+		Clock                                 m_clock;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	static void count(Counter counter, unsigned long long n = 1)
+	{
+		if (ENABLED && sink()) sink()->*counter += n;
+	}
+
+	// adds the counts of from into into, for collecting the stats of several workers
+	static void merge(CrackStats& into, const CrackStats& from)
+	{
+		into.nodes += from.nodes;
+		into.candidates += from.candidates;
+		into.pushRejections += from.pushRejections;
+		into.validationFailures += from.validationFailures;
+		into.lookups += from.lookups;
+		into.translations += from.translations;
+		into.transpositionHits += from.transpositionHits;
+		into.transpositionMisses += from.transpositionMisses;
+		if (from.maxDepth > into.maxDepth) into.maxDepth = from.maxDepth;
+		into.tokenizeTime += from.tokenizeTime;
+		into.translateTime += from.translateTime;
+		into.validateTime += from.validateTime;
+		into.lookupTime += from.lookupTime;
+	}
+
+private:
+	static CrackStats*& sink()
+	{
+		static thread_local CrackStats* stats = nullptr;
+		return stats;
+	}
+};
+
+#endif // STATS_H
@@ -1,50 +1,58 @@
 #include "provided.h"
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <vector>
 #include <algorithm>
 using namespace std;
 
 class TokenizerImpl
 {
 public:
-    TokenizerImpl(string separators);	// creates a vector of all the separators
+    TokenizerImpl(string separators);	// marks each of the separators in the table
     vector<string> tokenize(const std::string& s) const;	// return a vector of tokens 
+    void tokenize(const std::string& s, vector<string_view>& tokens) const;	// same, but as views into s
 private:
-	unordered_set<char> m_separators;
-	bool isSeparator(const char& a) const;
+	bool m_separators[256];	// indexed by the character as an unsigned char
+	bool isSeparator(char a) const { return m_separators[static_cast<unsigned char>(a)]; }
+	template <typename Add>
+	void forEachToken(const std::string& s, Add add) const;	// calls add(start, length) for each token
 };
 
 TokenizerImpl::TokenizerImpl(string separators)
 {
+	fill(m_separators, m_separators + 256, false);
 	for (unsigned int i = 0; i < separators.size(); ++i)
-	{
-		m_separators.insert(separators[i]);
-	}
+		m_separators[static_cast<unsigned char>(separators[i])] = true;
 }
 
-bool TokenizerImpl::isSeparator(const char& a) const
+template <typename Add>
+void TokenizerImpl::forEachToken(const std::string& s, Add add) const
 {
-	unordered_set<char>::const_iterator got = m_separators.find(a);
-	if (got != m_separators.end()) return true;	// if we didn't find the separator, return true
-	return false;
+	size_t i = 0;
+	while (i < s.size())	// go through the entire string s
+	{
+		while (i < s.size() && isSeparator(s[i]))	// skip to the start of a token
+			++i;
+		size_t start = i;
+		while (i < s.size() && !isSeparator(s[i]))	// and on to its end
+			++i;
+		if (i > start)
+			add(start, i - start);
+	}
 }
 
 vector<string> TokenizerImpl::tokenize(const std::string& s) const
 {
 	vector<string> tokens;
-	string cur;
-	for (unsigned int i = 0; i < s.size(); ++i)	// go through the entire string s
-	{
-		cur = "";
-		while (!isSeparator(s[i]) && i < s.size())	// add things to cur while it's not a separator
-		{
-			cur += s[i];
-			++i;
-		}
-		if (cur != "")	// add the string to the vector if cur isn't empty
-			tokens.push_back(cur);
-	}
-    return tokens; 
+	forEachToken(s, [&](size_t start, size_t length) { tokens.emplace_back(s, start, length); });
+	return tokens;
+}
+
+void TokenizerImpl::tokenize(const std::string& s, vector<string_view>& tokens) const
+{
+	tokens.clear();	// keeps its capacity, so a reused vector stops allocating
+	string_view all(s);
+	forEachToken(s, [&](size_t start, size_t length) { tokens.push_back(all.substr(start, length)); });
 }
 
 //******************** Tokenizer functions ************************************
@@ -66,3 +74,9 @@ vector<string> Tokenizer::tokenize(const std::string& s) const
 {
     return m_impl->tokenize(s);
 }
+
+
+void Tokenizer::tokenize(const std::string& s, std::vector<std::string_view>& tokens) const
+{
+    m_impl->tokenize(s, tokens);
+}
@@ -1,9 +1,11 @@
 #include "provided.h"
 #include "MyHash.h"
+#include "Stats.h"
 #include <vector>
-#include <unordered_map>
 #include <iostream>
 #include <string>
+#include <cctype>
+#include <random>
 using namespace std;
 
 class TranslatorImpl
@@ -11,87 +13,91 @@ class TranslatorImpl
 public:
 	TranslatorImpl();
 	bool pushMapping(string ciphertext, string plaintext);	// add a mapping from cipher -> plain
-	bool popMapping();	// put the top map onto the current mapping
+	bool popMapping();	// undo the most recent successful push
 	string getTranslation(const string& ciphertext) const;	// translates input using the current map
 
 private:
-	unordered_map<char, char> m_currMap;
-	std::vector<unordered_map<char, char>> m_Stack;	//vector of mapping tables, to be used as a stack
-	unsigned int m_size;		// keeps track of where the top of the stack is
-	bool isValidPair(const char& key, const char& value) const;
+	char m_forward[26];		// cipher letter -> plaintext letter (uppercase), '?' if unmapped
+	char m_reverse[26];		// plaintext letter -> cipher letter (uppercase), '?' if unused
+	std::vector<char> m_undoLog;			// cipher letters each push newly mapped, oldest first
+	std::vector<unsigned int> m_frames;		// size of the undo log before each push, to be used as a stack
+	void undoTo(unsigned int logSize);		// unmap every letter logged after logSize
 };
 
 
 TranslatorImpl::TranslatorImpl()
-	:m_size(0)
 {
-	for (int i = 0; i < 26; ++i)	// initialize the starting map with uppercase letters
-		m_currMap['A' + i] = '?';
+	for (int i = 0; i < 26; ++i)	// every letter starts out unmapped
+	{
+		m_forward[i] = '?';
+		m_reverse[i] = '?';
+	}
 }
 
 bool TranslatorImpl::pushMapping(string ciphertext, string plaintext)
 {
 	// check to make sure both strings are valid
 	if (ciphertext.size() != plaintext.size())	return false;	// strings must match in size
-																// initialize current map
-	unordered_map<char, char> tempMap = m_currMap;
-	// check to make sure that the character mappings are valid letters and consistent
-	for (unsigned short i = 0; i < ciphertext.size(); ++i)
+
+	unsigned int start = m_undoLog.size();
+	// map each pair as we go, so a push that contradicts itself is caught too. only letters that were
+	// unmapped get logged, so undoing a push touches nothing the earlier pushes set
+	for (unsigned int i = 0; i < ciphertext.size(); ++i)
 	{
-		if (!isalpha(ciphertext[i]) || !isalpha(plaintext[i]))	// check that they're letters
-			if (ciphertext[i] != plaintext[i]) return false;
-		if (!isValidPair(ciphertext[i], plaintext[i])) return false;	// check that the pair is valid
+		unsigned char c = ciphertext[i], p = plaintext[i];
+		if (!isalpha(c) || !isalpha(p))	// non-letters must map to themselves
+		{
+			if (c != p) { Stats::count(&CrackStats::pushRejections); undoTo(start); return false; }
+			continue;
+		}
+		int key = toupper(c) - 'A', value = toupper(p) - 'A';
+		if (m_forward[key] == 'A' + value) continue;	// already maps this way
+		if (m_forward[key] != '?' || m_reverse[value] != '?')	// either letter is already taken by another mapping
+		{
+			Stats::count(&CrackStats::pushRejections);
+			undoTo(start);
+			return false;
+		}
+		m_forward[key] = 'A' + value;
+		m_reverse[value] = 'A' + key;
+		m_undoLog.push_back(key);
 	}
-	// Once we reach here, both strings are valid. update the current mapping, update the stack, and return true
-	for (unsigned short i = 0; i < ciphertext.size(); ++i)
-		tempMap[toupper(ciphertext[i])] = toupper(plaintext[i]);
-	m_Stack.push_back(m_currMap);
-	m_size++;
-	m_currMap = tempMap;
+	m_frames.push_back(start);
 	return true;
 }
 
-// make it so we actually get rid of the things.
 bool TranslatorImpl::popMapping()
 {
-	if (m_size == 0) return false;	// if stack is empty, return false
-	m_currMap = m_Stack[m_size - 1];	// update the current map to the top of the stack
-	m_Stack.pop_back();
-	m_size--;	// reduce the size of the stack 
-	return true;  // This compiles, but may not be correct
+	if (m_frames.empty()) return false;	// if stack is empty, return false
+	undoTo(m_frames.back());
+	m_frames.pop_back();
+	return true;
 }
 
-bool TranslatorImpl::isValidPair(const char& key, const char& value) const
+void TranslatorImpl::undoTo(unsigned int logSize)
 {
-	unordered_map<char, char>::const_iterator posKey = m_currMap.find(toupper(key));	// get the position/place of the key
-	// if value appears anywhere in the map besides where the key is return false
-	for (unordered_map<char, char>::const_iterator posVal = m_currMap.begin() ; posVal != m_currMap.end() ; posVal++)
+	while (m_undoLog.size() > logSize)
 	{
-		if (posVal == posKey) continue;
-		if (posVal->second == toupper(value)) return false;
+		int key = m_undoLog.back();
+		m_reverse[m_forward[key] - 'A'] = '?';
+		m_forward[key] = '?';
+		m_undoLog.pop_back();
 	}
-	// if the key is unmapped or already maps to the correct value, return true
-	if (posKey->second == toupper(value) || posKey->second == '?') return true; 
-	return false;
 }
 
 string TranslatorImpl::getTranslation(const string& ciphertext) const
 {
-	string translated = "";
-	char cur;
-	for (unsigned int i = 0; i < ciphertext.size(); ++i)
+	Stats::count(&CrackStats::translations);
+	Stats::Timer timer(&CrackStats::translateTime);
+	string translated(ciphertext);
+	for (unsigned int i = 0; i < translated.size(); ++i)
 	{
-		if (!isalpha(ciphertext[i]))	// if the character isn't a letter, just add it to the translated string
-			cur = ciphertext[i];
-		else					// if the character is a letter, then add the value it maps to to the translated string
-		{
-			unordered_map<char, char>::const_iterator it = m_currMap.find(toupper(ciphertext[i]));
-			if (it != m_currMap.end())	cur = it->second;
-		}
+		unsigned char c = translated[i];
+		if (!isalpha(c)) continue;	// if the character isn't a letter, leave it as is
 
-		// make sure we keep lowercase things lowercase and uppercase things uppercase
-		if (islower(ciphertext[i])) cur = tolower(cur);
-		translated += cur;
+		// the character is a letter, so use the value it maps to, keeping lowercase things lowercase and uppercase things uppercase
+		char cur = m_forward[toupper(c) - 'A'];
+		translated[i] = (islower(c) ? tolower(cur) : cur);
 	}
 	return translated;
 }
@@ -125,3 +131,20 @@ string Translator::getTranslation(const string& ciphertext) const
 {
 	return m_impl->getTranslation(ciphertext);
 }
+
+//******************** encrypt ************************************
+
+string encrypt(const string& plaintext, unsigned int seed)
+{
+	// mt19937 is the same everywhere, but shuffle and the distributions aren't, so shuffle by hand
+	string plaintextAlphabet = "abcdefghijklmnopqrstuvwxyz";
+	string ciphertextAlphabet(plaintextAlphabet);
+	mt19937 e(seed);
+	for (unsigned int i = 25; i > 0; --i)
+		swap(ciphertextAlphabet[i], ciphertextAlphabet[e() % (i + 1)]);
+
+	// run translator (opposite to the intended direction)
+	Translator t;
+	t.pushMapping(plaintextAlphabet, ciphertextAlphabet);
+	return t.getTranslation(plaintext);
+}
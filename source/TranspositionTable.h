@@ -0,0 +1,73 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/////////////////////////////////////////////////////////////
+// TranspositionTable Interface
+/////////////////////////////////////////////////////////////
+
+// A fixed size set of 64 bit keys, for remembering which search states are already known to lead
+// nowhere. It never grows: the keys go into buckets of BUCKET_SIZE slots, and adding to a full
+// bucket throws out one of its keys, picked by bits of the new key. Forgetting a key only costs
+// searching that state again.
+//
+// Safe to share between threads without locks, since each slot is a single atomic word. Key 0 marks
+// an empty slot, so it's stored as 1 instead.
+class TranspositionTable
+{
+public:
+	static const unsigned int BUCKET_SIZE = 4;
+
+	// room for about maxEntries keys, rounded down to whole buckets (at least one)
+	TranspositionTable(std::size_t maxEntries)
+	{
+		m_nBuckets = 1;
+		while (m_nBuckets * 2 * BUCKET_SIZE <= maxEntries)
+			m_nBuckets *= 2;
+		m_slots.reset(new std::atomic<std::uint64_t>[m_nBuckets * BUCKET_SIZE]);
+		for (std::size_t i = 0; i < m_nBuckets * BUCKET_SIZE; ++i)
+			m_slots[i].store(0, std::memory_order_relaxed);
+	}
+
+	bool contains(std::uint64_t key) const
+	{
+		key = stored(key);
+		const std::atomic<std::uint64_t>* bucket = getBucket(key);
+		for (unsigned int i = 0; i < BUCKET_SIZE; ++i)
+			if (bucket[i].load(std::memory_order_relaxed) == key) return true;
+		return false;
+	}
+	void add(std::uint64_t key)
+	{
+		key = stored(key);
+		std::atomic<std::uint64_t>* bucket = getBucket(key);
+		for (unsigned int i = 0; i < BUCKET_SIZE; ++i)
+		{
+			std::uint64_t current = bucket[i].load(std::memory_order_relaxed);
+			if (current == key) return;	// already there
+			if (current == 0) { bucket[i].store(key, std::memory_order_relaxed); return; }
+		}
+		bucket[(key >> 60) % BUCKET_SIZE].store(key, std::memory_order_relaxed);	// full, evict one
+	}
+	std::size_t capacity() const { return m_nBuckets * BUCKET_SIZE; }
+
+	// C++11 syntax for preventing copying and assignment
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+private:
+	std::unique_ptr<std::atomic<std::uint64_t>[]> m_slots;
+	std::size_t                                   m_nBuckets;	// a power of two
+
+	static std::uint64_t stored(std::uint64_t key) { return key == 0 ? 1 : key; }
+	std::atomic<std::uint64_t>* getBucket(std::uint64_t key) const
+	{
+		return &m_slots[(key & (m_nBuckets - 1)) * BUCKET_SIZE];
+	}
+};
+
+#endif // TRANSPOSITION_TABLE_H
@@ -1,87 +1,498 @@
 #include "provided.h"
 #include "MyHash.h"
+#include "Stats.h"
+#include "Dawg.h"
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <string_view>
+#include <algorithm>
+#include <sys/stat.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WORDLIST_X86_KERNELS
+#include <immintrin.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
+/////////////////////////////////////////////////////////////
+// Word list index layout
+/////////////////////////////////////////////////////////////
+
+// The word list is kept as one contiguous image, the same bytes whether it was built from the text
+// file or mapped straight from a saved index file (see WordList::saveIndex). Every offset is from
+// the start of the image, and every section starts on an 8 byte boundary:
+//
+//   IndexHeader
+//   slots:  nSlots uint32s, an open addressing table of (group index + 1), 0 if empty
+//   groups: nGroups IndexGroups, one per letter pattern
+//   chars:  each group's words back to back (they all share its length)
+//   bits:   for groups of at least BITSET_MIN_WORDS words, a bitset of the group's words for every
+//           position and letter, set where that word has that letter there (see findCandidates)
+//   words:  nWordSlots uint64s, an open addressing table of every word for contains (see WordSlot)
+
+const char          INDEX_MAGIC[8] = { 'S', 'S', 'C', 'W', 'I', 'D', 'X', '\0' };
+const std::uint32_t INDEX_VERSION  = 4;
+
+// smaller groups are scanned word by word, which is about as fast and saves the space
+const std::uint32_t BITSET_MIN_WORDS = 64;
+
+struct IndexHeader {
+	char          magic[8];
+	std::uint32_t version;
+	std::uint32_t nGroups;
+	std::uint32_t nSlots;			// a power of two
+	std::uint32_t nWords;
+	std::uint64_t sourceSize;		// size and modification time of the text file the index was built from,
+	std::int64_t  sourceTime;		// so a stale index gets ignored
+	std::uint64_t slotsOffset;
+	std::uint64_t groupsOffset;
+	std::uint64_t charsOffset;
+	std::uint64_t bitsOffset;
+	std::uint64_t wordSlotsOffset;
+	std::uint32_t nWordSlots;		// a power of two
+	std::uint32_t unused;
+	std::uint64_t imageSize;
+};
+
+// A word's letter pattern packed into integers, 5 bits a position and 12 positions to a uint64.
+// A letter's code is 1 + how many different letters came before its first appearance ("hello" is
+// 1 2 3 3 4), an apostrophe is APOSTROPHE_CODE and the positions past the end are 0, so the key
+// also gives the length. Two words have the same pattern exactly when they have the same key.
+const unsigned int  CODES_PER_BLOCK    = 12;
+const unsigned int  MAX_PATTERN_LENGTH = 3 * CODES_PER_BLOCK;	// longer than any english word
+const std::uint64_t APOSTROPHE_CODE    = 27;
+
+struct PatternKey {
+	std::uint64_t codes[3];
+
+	bool operator==(const PatternKey& other) const
+	{
+		return codes[0] == other.codes[0] && codes[1] == other.codes[1] && codes[2] == other.codes[2];
+	}
+};
+
+struct IndexGroup {
+	PatternKey    pattern;
+	std::uint32_t words;	// offset of the first word in the chars section, the next one starts length bytes later
+	std::uint32_t nWords;
+	std::uint32_t length;	// length of the pattern and of every word in the group
+	std::uint32_t bits;		// 1 + where the group's bitsets start in the bits section (in uint64s), 0 if it has none
+};
+
+// A slot of the word table: where the word starts in the chars section in the low 32 bits, its length
+// in the next 8 and the top 24 bits of its hash above that, 0 if empty. A lookup only reads the word
+// itself when both of those agree, so a miss almost never leaves the table.
+struct WordSlot {
+	static std::uint64_t make(std::uint32_t offset, size_t length, std::uint64_t hash)
+	{
+		return offset | (static_cast<std::uint64_t>(length) << 32) | (hashTag(hash) << 40);
+	}
+	static std::uint64_t hashTag(std::uint64_t hash) { return hash >> 40; }
+	static std::uint32_t offset(std::uint64_t slot) { return static_cast<std::uint32_t>(slot); }
+	static size_t        length(std::uint64_t slot) { return static_cast<size_t>((slot >> 32) & 0xFF); }
+	static std::uint64_t tag(std::uint64_t slot)    { return slot >> 40; }
+};
+
+// how many uint64s one bitset of a group takes
+static std::uint32_t bitsetBlocks(const IndexGroup& group)
+{
+	return (group.nWords + 63) / 64;
+}
+
+// index of the lowest set bit of a nonzero block
+static unsigned int lowestBit(std::uint64_t block)
+{
+#if defined(__GNUC__)
+	return static_cast<unsigned int>(__builtin_ctzll(block));
+#else
+	unsigned int i = 0;
+	while (!(block & 1)) { block >>= 1; ++i; }
+	return i;
+#endif
+}
+
+// number of set bits in a block
+static unsigned int countBits(std::uint64_t block)
+{
+#if defined(__GNUC__)
+	return static_cast<unsigned int>(__builtin_popcountll(block));
+#else
+	unsigned int n = 0;
+	for (; block; block &= block - 1) ++n;
+	return n;
+#endif
+}
+
+// the key of a word, false if it has something besides letters and apostrophes or is too long for one
+// (either way no word in the list has its pattern)
+static bool getPattern(const char* word, size_t length, PatternKey& key)
+{
+	key.codes[0] = key.codes[1] = key.codes[2] = 0;
+	if (length > MAX_PATTERN_LENGTH) return false;
+	std::uint64_t letterCodes[26] = { 0 };
+	std::uint64_t nextCode = 1;
+	for (size_t i = 0; i < length; ++i)
+	{
+		unsigned char c = word[i];
+		std::uint64_t code;
+		if (isalpha(c))
+		{
+			std::uint64_t& letterCode = letterCodes[tolower(c) - 'a'];
+			if (letterCode == 0) letterCode = nextCode++;	// first time we see this letter
+			code = letterCode;
+		}
+		else if (c == '\'') code = APOSTROPHE_CODE;
+		else return false;
+		key.codes[i / CODES_PER_BLOCK] |= code << (5 * (i % CODES_PER_BLOCK));
+	}
+	return true;
+}
+
+// the index is shared between builds, so it can't depend on std::hash
+static std::uint64_t hashPattern(const PatternKey& key)
+{
+	std::uint64_t h = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		h = (h ^ key.codes[i]) * 0x9E3779B97F4A7C15ull;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+// FNV-1a of the lowercase word, then mixed so the top bits (the slot tag) are good too
+static std::uint64_t hashWord(const char* word, size_t length)
+{
+	std::uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < length; ++i)
+	{
+		h ^= static_cast<unsigned char>(tolower(static_cast<unsigned char>(word[i])));
+		h *= 1099511628211ull;
+	}
+	return (h ^ (h >> 32)) * 0x9E3779B97F4A7C15ull;
+}
+
+struct PatternKeyHash {
+	size_t operator()(const PatternKey& key) const { return static_cast<size_t>(hashPattern(key)); }
+};
+
+static size_t alignTo8(size_t n)
+{
+	return (n + 7) & ~static_cast<size_t>(7);
+}
+
+// size and modification time of a file, false if it doesn't exist
+static bool getFileStamp(const string& filename, std::uint64_t& size, std::int64_t& time)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return false;
+	size = static_cast<std::uint64_t>(info.st_size);
+	time = static_cast<std::int64_t>(info.st_mtime);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////
+// Matching the words of a small group against a translation
+/////////////////////////////////////////////////////////////
+
+// A group's words sit back to back at a fixed stride, so one vector register holds several whole
+// words. The translation gets repeated at that stride (the letter we want at each byte and whether
+// we know it), one compare checks every word in the register, and each word's slice of the mismatch
+// bits says whether it matched. What's left at the end of a group, too short for a full load, goes
+// word by word. The kernel is picked once, from what the CPU we're running on supports.
+
+const unsigned int MAX_TILE = 32;	// widest register we use, in bytes
+
+struct TranslationTile {
+	unsigned char letters[MAX_PATTERN_LENGTH];	// the lowercase letter wanted at each byte, 0 if unknown; whole words, not just a register's worth
+	std::uint32_t length;				// of the words, which the tile repeats at
+};
+
+// the tile for a translation of a word of length letters
+static void makeTile(const string& currTranslation, TranslationTile& tile)
+{
+	tile.length = static_cast<std::uint32_t>(currTranslation.size());
+	for (unsigned int j = 0; j < MAX_PATTERN_LENGTH; ++j)	// words longer than a register still get every letter
+	{
+		unsigned char c = currTranslation[j % tile.length];
+		tile.letters[j] = isalpha(c) ? static_cast<unsigned char>(tolower(c)) : 0;	// the pattern already matched the apostrophes
+	}
+}
+
+// sets bit i of the result if word i of a group of fewer than 64 words matches the tile
+typedef std::uint64_t (*MatchKernel)(const char* words, std::uint32_t nWords, const TranslationTile& tile);
+
+static bool wordMatches(const char* word, const TranslationTile& tile)
+{
+	for (std::uint32_t j = 0; j < tile.length; ++j)
+		if (tile.letters[j] && static_cast<unsigned char>(word[j]) != tile.letters[j]) return false;
+	return true;
+}
+
+static std::uint64_t matchWordsScalar(const char* words, std::uint32_t nWords, const TranslationTile& tile)
+{
+	std::uint64_t matches = 0;
+	for (std::uint32_t i = 0; i < nWords; ++i)
+		if (wordMatches(words + i * tile.length, tile)) matches |= std::uint64_t(1) << i;
+	return matches;
+}
+
+// the words a mismatch mask of a full register says matched, as bits from first
+static std::uint64_t matchedWords(std::uint32_t mismatches, std::uint32_t perLoad, std::uint32_t length, std::uint32_t first)
+{
+	std::uint64_t matches = 0;
+	std::uint64_t wordBits = (std::uint64_t(1) << length) - 1;
+	for (std::uint32_t k = 0; k < perLoad; ++k)
+		if (((mismatches >> (k * length)) & wordBits) == 0) matches |= std::uint64_t(1) << (first + k);
+	return matches;
+}
+
+// the bits of a register's bytes that are inside whole words and that we know the letter of
+static std::uint32_t knownBits(const TranslationTile& tile, std::uint32_t span)
+{
+	std::uint32_t bits = 0;
+	for (std::uint32_t j = 0; j < span; ++j)
+		if (tile.letters[j]) bits |= std::uint32_t(1) << j;
+	return bits;
+}
+
+#ifdef WORDLIST_X86_KERNELS
+__attribute__((target("sse2")))
+static std::uint64_t matchWordsSSE2(const char* words, std::uint32_t nWords, const TranslationTile& tile)
+{
+	std::uint32_t perLoad = 16 / tile.length;
+	if (perLoad == 0) return matchWordsScalar(words, nWords, tile);
+	std::uint32_t known = knownBits(tile, perLoad * tile.length);
+	__m128i letters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tile.letters));
+	std::uint64_t matches = 0;
+	std::uint32_t i = 0;
+	for (; i * tile.length + 16 <= nWords * tile.length; i += perLoad)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i * tile.length));
+		std::uint32_t equal = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, letters)));
+		matches |= matchedWords(~equal & known, perLoad, tile.length, i);
+	}
+	for (; i < nWords; ++i)	// the rest would read past the group
+		if (wordMatches(words + i * tile.length, tile)) matches |= std::uint64_t(1) << i;
+	return matches;
+}
+
+__attribute__((target("avx2")))
+static std::uint64_t matchWordsAVX2(const char* words, std::uint32_t nWords, const TranslationTile& tile)
+{
+	std::uint32_t perLoad = 32 / tile.length;
+	if (perLoad == 0) return matchWordsScalar(words, nWords, tile);
+	std::uint32_t known = knownBits(tile, perLoad * tile.length);
+	__m256i letters = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tile.letters));
+	std::uint64_t matches = 0;
+	std::uint32_t i = 0;
+	for (; i * tile.length + 32 <= nWords * tile.length; i += perLoad)
+	{
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i * tile.length));
+		std::uint32_t equal = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, letters)));
+		matches |= matchedWords(~equal & known, perLoad, tile.length, i);
+	}
+	for (; i < nWords; ++i)
+		if (wordMatches(words + i * tile.length, tile)) matches |= std::uint64_t(1) << i;
+	return matches;
+}
+#endif
+
+static MatchKernel chooseMatchKernel()
+{
+#ifdef WORDLIST_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return matchWordsAVX2;
+	if (__builtin_cpu_supports("sse2")) return matchWordsSSE2;
+#endif
+	return matchWordsScalar;
+}
+
+static const MatchKernel matchWords = chooseMatchKernel();
+
+/////////////////////////////////////////////////////////////
+// MappedFile: read only view of a whole file
+/////////////////////////////////////////////////////////////
+
+// maps the file where the platform allows it, otherwise reads it into memory
+class MappedFile
+{
+public:
+	MappedFile() :m_data(nullptr), m_size(0) {}
+	~MappedFile() { close(); }
+	bool open(const string& filename);
+	void close();
+	const char* data() const { return m_data; }
+	size_t      size() const { return m_size; }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+private:
+	const char*       m_data;
+	size_t            m_size;
+	vector<uint64_t>  m_buffer;	// only used when we can't map; uint64_t keeps it 8 byte aligned
+};
+
+bool MappedFile::open(const string& filename)
+{
+	close();
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// the mapping keeps the file alive on its own
+	if (mapped == MAP_FAILED) return false;
+	m_data = static_cast<const char*>(mapped);
+	m_size = static_cast<size_t>(info.st_size);
+	return true;
+#else
+	ifstream file(filename, ios::binary | ios::ate);
+	if (!file) return false;
+	streamoff size = file.tellg();
+	if (size <= 0) return false;
+	m_buffer.resize((static_cast<size_t>(size) + 7) / 8);
+	file.seekg(0, ios::beg);
+	if (!file.read(reinterpret_cast<char*>(m_buffer.data()), size)) return false;
+	m_data = reinterpret_cast<const char*>(m_buffer.data());
+	m_size = static_cast<size_t>(size);
+	return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+	if (m_data) munmap(const_cast<char*>(m_data), m_size);
+#endif
+	m_buffer.clear();
+	m_data = nullptr;
+	m_size = 0;
+}
+
+/////////////////////////////////////////////////////////////
+// WordListImpl
+/////////////////////////////////////////////////////////////
 
 class WordListImpl
 {
 public:
 	WordListImpl();
 	~WordListImpl();
+	void setBackend(WordListBackend backend) { m_backend = backend; }
     bool loadWordList(string filename);	// load words into the wordlist
-    bool contains(string word) const;	// returns true if a word is in the list
-    vector<string> findCandidates(string cipherWord, string currTranslation) const;	// returns a vector of potential candidates given an untranslated and (partially) translated word
+    bool saveIndex(string filename) const;	// write the loaded list as an index file
+    bool contains(const string& word) const;	// returns true if a word is in the list
+    void findCandidates(const string& cipherWord, const string& currTranslation, vector<string_view>& candidates, string& storage) const;	// fills candidates with the words matching an untranslated and (partially) translated word
+    size_t countCandidates(const string& cipherWord, const string& currTranslation) const;	// how many candidates findCandidates would find
+	size_t memoryUsage() const;
 private:
-	MyHash<string, vector<string>>* m_patternToWords;
-	bool matchesTranslation(const std::string& input, const std::string& currTranslation) const;
-	// gets the pattern of a word
-	string getPattern(const string& input) const 
-{
-	char replacements[]{ 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K',
-		'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S' /*, 'T', 'U', 'V', 'W', 'X', 'Y', 'Z' */};
-	short usedChars[27];
-	for (int i = 0; i < 27; ++i) usedChars[i] = -1;
-	unsigned short counter = 0;
-	string temp = "";
-	unsigned char cur;
-
-	// go through the string and create a pattern for it
-	for (unsigned int i = 0; i < input.size(); ++i)
-	{
-		int charVal;
-		if      (isupper(input[i])) charVal = input[i] - 'A';	// deal with uppercase, lowercase, and apostrophes separately
-		else if (islower(input[i])) charVal = input[i] - 'a';
-		else    { temp += input[i]; continue; }		// if the character isn't a letter (!, ', etc.), add it to the word unchanged
-
-		if (usedChars[charVal] == -1)	// If we haven't used this letter yet
-		{
-			cur = replacements[counter];	// change the letter
-			usedChars[charVal] = counter;	// mark the letter as used and save the key it maps to
-			counter++;
-		}
-		else	// if we have already used this letter
-		{
-			short t = usedChars[charVal];
-			cur = replacements[t];
-		}
-		temp += tolower(cur);
+	WordListBackend     m_backend;	// what the next load builds
+	bool                m_usingDawg;	// what the current list is
+	Dawg                m_dawg;	// holds no word text, so findCandidates copies its matches into the caller's storage
+
+	MappedFile          m_file;		// the index file, when we loaded one
+	vector<uint64_t>    m_built;	// the image, when we built it from a text file
+	const char*         m_image;	// whichever of the two is in use
+	const IndexHeader*  m_header;
+	const std::uint32_t* m_slots;
+	const IndexGroup*   m_groups;
+	const char*         m_chars;
+	const std::uint64_t* m_bits;
+	const std::uint64_t* m_wordSlots;
+
+	bool loadIndex(const string& indexname, const string& filename);	// false if there is no usable index
+	bool loadText(const string& filename);
+	bool loadDawg(const string& filename);
+	bool useImage(const char* image, size_t size);	// check an image and point the section pointers at it
+	const IndexGroup* findGroup(const string& word) const;	// the group of word's pattern, nullptr if no word has it
+	unsigned int knownBitsets(const IndexGroup& group, const string& currTranslation, const std::uint64_t* known[26]) const;	// the bitsets of the letters the translation knows
+	std::uint64_t lastBlockMask(const IndexGroup& group) const	// the bits of a group's last bitset block that are words
+	{
+		return group.nWords % 64 == 0 ? ~std::uint64_t(0) : (std::uint64_t(1) << (group.nWords % 64)) - 1;
 	}
-	return temp;
-}	
 };
 
 WordListImpl::WordListImpl()
+	:m_backend(WordListBackend::Index), m_usingDawg(false),
+	 m_image(nullptr), m_header(nullptr), m_slots(nullptr), m_groups(nullptr), m_chars(nullptr), m_bits(nullptr),
+	 m_wordSlots(nullptr)
 {
-	m_patternToWords = new MyHash<std::string, std::vector<std::string>>;
 }
 
 WordListImpl::~WordListImpl()
 {
-	delete m_patternToWords;
 }
 
-bool WordListImpl::matchesTranslation(const std::string& input, const std::string& currTranslation) const
+bool WordListImpl::loadWordList(std::string filename)
+{
+	// first reset
+	m_file.close();
+	m_built.clear();
+	m_image = nullptr;
+	m_header = nullptr;
+	m_dawg.clear();
+	m_usingDawg = (m_backend == WordListBackend::Dawg);
+
+	if (m_usingDawg)
+		return loadDawg(filename);
+	if (loadIndex(filename + ".idx", filename))	// a saved index skips all the parsing
+		return true;
+	return loadText(filename);
+}
+
+bool WordListImpl::loadIndex(const string& indexname, const string& filename)
 {
-	for (unsigned int i = 0; i < currTranslation.size(); ++i)	// loop through both strings
+	if (!m_file.open(indexname))
+		return false;
+	if (!useImage(m_file.data(), m_file.size()))
 	{
-		if (currTranslation[i] == '?') continue;
-		else if (input[i] != currTranslation[i]) return false;	// if the values don't match, then return false
+		m_file.close();
+		return false;
 	}
-	return true;	// if all values match, return true
+	std::uint64_t size;
+	std::int64_t time;
+	if (getFileStamp(filename, size, time) && (size != m_header->sourceSize || time != m_header->sourceTime))
+	{
+		m_file.close();	// the text file changed since the index was saved
+		m_header = nullptr;
+		return false;
+	}
+	return true;
 }
 
-bool WordListImpl::loadWordList(std::string filename)
+bool WordListImpl::loadText(const string& filename)
 {
-	m_patternToWords->reset();	// first reset
 	ifstream wordfile(filename);
 	if (!wordfile)	// if we can't find/open the file, return false
 		return false;
+	// english lists come out around one pattern per 40-50 bytes of file, so size the map up front
+	wordfile.seekg(0, ios::end);
+	streamoff fileSize = wordfile.tellg();
+	wordfile.seekg(0, ios::beg);
+	MyHash<PatternKey, vector<string>, PatternKeyHash> patternToWords;
+	vector<PatternKey> patterns;	// every pattern in the order it was first seen, since MyHash can't be iterated
+	if (fileSize > 0)
+		patternToWords.reserve(static_cast<unsigned long>(fileSize / 40));
+
 	std::string currStr;
+	size_t nWords = 0, nChars = 0;
 	bool skip;	// loop through the text file
 	while (getline(wordfile, currStr))
 	{
@@ -93,51 +504,352 @@ bool WordListImpl::loadWordList(std::string filename)
 			}
 			if (isupper(currStr[i])) currStr[i] = tolower(currStr[i]);		// store words as all lowercase
 		}
-		if (skip) continue;	// if word has weird characters, skip it
+		PatternKey currPattern;
+		if (skip || currStr.empty() || !getPattern(currStr.data(), currStr.size(), currPattern)) continue;	// if word has weird characters, skip it
 		
 		// add the word to the hash map
-		string currPattern = getPattern(currStr);	// get the pattern of the current string
-		vector<string>* checkRepeat = (m_patternToWords->find(currPattern));	// checkRepeat gets the address of any existing pattern's word list vector
-		vector<string> currVec;
+		vector<string>* checkRepeat = (patternToWords.find(currPattern));	// checkRepeat gets the address of any existing pattern's word list vector
 		if(checkRepeat) 
 			checkRepeat->push_back(currStr);		// If vector isn't empty, update it
 		else		// otherwise, add the new vector to the map
 		{
-			currVec.push_back(currStr);		// add
-			m_patternToWords->associate(currPattern, currVec);
+			patternToWords.associate(currPattern, vector<string>(1, currStr));
+			patterns.push_back(currPattern);
+		}
+		nWords++;
+		nChars += currStr.size();
+	}
+
+	// lay the map out as an image
+	std::uint32_t nSlots = 16;
+	while (nSlots < patterns.size() * 2)	// keep the table at most half full
+		nSlots *= 2;
+	size_t slotsOffset  = alignTo8(sizeof(IndexHeader));
+	size_t groupsOffset = alignTo8(slotsOffset + nSlots * sizeof(std::uint32_t));
+	size_t charsOffset  = alignTo8(groupsOffset + patterns.size() * sizeof(IndexGroup));
+	size_t nBitBlocks = 0;
+	for (std::uint32_t g = 0; g < patterns.size(); ++g)
+	{
+		const vector<string>& words = *patternToWords.find(patterns[g]);
+		if (words.size() >= BITSET_MIN_WORDS)
+			nBitBlocks += words[0].size() * 26 * ((words.size() + 63) / 64);
+	}
+	std::uint32_t nWordSlots = 16;
+	while (nWordSlots < nWords * 2)
+		nWordSlots *= 2;
+	size_t bitsOffset   = alignTo8(charsOffset + nChars);
+	size_t wordSlotsOffset = bitsOffset + nBitBlocks * sizeof(std::uint64_t);
+	size_t imageSize    = wordSlotsOffset + nWordSlots * sizeof(std::uint64_t);
+	m_built.assign(imageSize / 8, 0);
+	char* image = reinterpret_cast<char*>(m_built.data());
+
+	IndexHeader* header = reinterpret_cast<IndexHeader*>(image);
+	memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header->version = INDEX_VERSION;
+	header->nGroups = static_cast<std::uint32_t>(patterns.size());
+	header->nSlots = nSlots;
+	header->nWords = static_cast<std::uint32_t>(nWords);
+	if (!getFileStamp(filename, header->sourceSize, header->sourceTime))
+		header->sourceSize = header->sourceTime = 0;
+	header->slotsOffset = slotsOffset;
+	header->groupsOffset = groupsOffset;
+	header->charsOffset = charsOffset;
+	header->bitsOffset = bitsOffset;
+	header->wordSlotsOffset = wordSlotsOffset;
+	header->nWordSlots = nWordSlots;
+	header->imageSize = imageSize;
+
+	std::uint32_t* slots = reinterpret_cast<std::uint32_t*>(image + slotsOffset);
+	IndexGroup* groups = reinterpret_cast<IndexGroup*>(image + groupsOffset);
+	char* chars = image + charsOffset;
+	std::uint64_t* bits = reinterpret_cast<std::uint64_t*>(image + bitsOffset);
+	std::uint64_t* wordSlots = reinterpret_cast<std::uint64_t*>(image + wordSlotsOffset);
+	std::uint32_t charsUsed = 0, bitsUsed = 0;
+	for (std::uint32_t g = 0; g < patterns.size(); ++g)
+	{
+		const PatternKey& pattern = patterns[g];
+		const vector<string>& words = *patternToWords.find(pattern);
+		groups[g].pattern = pattern;
+		groups[g].length = static_cast<std::uint32_t>(words[0].size());
+		groups[g].words = charsUsed;
+		groups[g].nWords = static_cast<std::uint32_t>(words.size());
+		for (unsigned int i = 0; i < words.size(); ++i)
+		{
+			memcpy(chars + charsUsed, words[i].data(), words[i].size());
+			std::uint64_t hash = hashWord(words[i].data(), words[i].size());
+			std::uint32_t pos = static_cast<std::uint32_t>(hash) & (nWordSlots - 1);
+			bool duplicate = false;	// the list may have a word twice, the table only needs it once
+			for (; wordSlots[pos] != 0 && !duplicate; pos = (pos + 1) & (nWordSlots - 1))
+				duplicate = WordSlot::tag(wordSlots[pos]) == WordSlot::hashTag(hash) && WordSlot::length(wordSlots[pos]) == words[i].size()
+					&& memcmp(chars + WordSlot::offset(wordSlots[pos]), words[i].data(), words[i].size()) == 0;
+			if (!duplicate)
+				wordSlots[pos] = WordSlot::make(charsUsed, words[i].size(), hash);
+			charsUsed += static_cast<std::uint32_t>(words[i].size());
+		}
+		groups[g].bits = 0;
+		if (words.size() >= BITSET_MIN_WORDS)	// bitset at (position * 26 + letter) * blocks has bit i set if word i has letter there
+		{
+			std::uint32_t blocks = bitsetBlocks(groups[g]);
+			groups[g].bits = bitsUsed + 1;
+			for (unsigned int i = 0; i < words.size(); ++i)
+				for (unsigned int pos = 0; pos < words[i].size(); ++pos)
+					if (isalpha(static_cast<unsigned char>(words[i][pos])))
+						bits[bitsUsed + (pos * 26 + (words[i][pos] - 'a')) * blocks + i / 64] |= std::uint64_t(1) << (i % 64);
+			bitsUsed += groups[g].length * 26 * blocks;
+		}
+		std::uint32_t pos = static_cast<std::uint32_t>(hashPattern(pattern)) & (nSlots - 1);
+		while (slots[pos] != 0)	// linear probing
+			pos = (pos + 1) & (nSlots - 1);
+		slots[pos] = g + 1;
+	}
+	return useImage(image, imageSize);
+}
+
+bool WordListImpl::loadDawg(const string& filename)
+{
+	// the whole file in one string, lowercased in place, with a view of every usable line. for a huge
+	// list that's far smaller than a string per word
+	ifstream wordfile(filename, ios::binary);
+	if (!wordfile)
+		return false;
+	string text((istreambuf_iterator<char>(wordfile)), istreambuf_iterator<char>());
+	vector<string_view> words;
+	size_t start = 0;
+	while (start < text.size())
+	{
+		size_t end = text.find('\n', start);
+		if (end == string::npos) end = text.size();
+		bool skip = (end == start || end - start > MAX_PATTERN_LENGTH);	// same words the index keeps
+		for (size_t i = start; i < end && !skip; ++i)
+		{
+			if (!isalpha(static_cast<unsigned char>(text[i])) && text[i] != '\'') skip = true;
+			else text[i] = static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
 		}
+		if (!skip)
+			words.push_back(string_view(text.data() + start, end - start));
+		start = end + 1;
 	}
+	sort(words.begin(), words.end());
+	return m_dawg.build(words);
+}
+
+// true if count items of itemSize bytes starting at offset fit in an image of size bytes, aligned for them
+static bool fitsInImage(std::uint64_t offset, std::uint64_t count, size_t itemSize, size_t size)
+{
+	return offset % itemSize == 0 && offset <= size && count <= (size - offset) / itemSize;
+}
+
+// true if isSound likes every used slot of a hash table, and there is an empty one to end a probe
+template <typename Slot, typename Check>
+static bool slotsAreSound(const Slot* slots, std::uint32_t nSlots, Check isSound)
+{
+	bool hasEmpty = false;
+	for (std::uint32_t i = 0; i < nSlots; ++i)
+	{
+		if (slots[i] == 0) hasEmpty = true;
+		else if (!isSound(slots[i])) return false;
+	}
+	return hasEmpty;
+}
+
+bool WordListImpl::useImage(const char* image, size_t size)
+{
+	const IndexHeader* header = reinterpret_cast<const IndexHeader*>(image);
+	if (size < sizeof(IndexHeader) || memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+		|| header->version != INDEX_VERSION || header->imageSize != size
+		|| header->nSlots == 0 || (header->nSlots & (header->nSlots - 1)) != 0
+		|| header->nWordSlots == 0 || (header->nWordSlots & (header->nWordSlots - 1)) != 0)
+		return false;	// not an index, or one from another version
+
+	// a damaged or hand made file could point anywhere, so check every section and everything that points
+	// into one before trusting any of it. the chars and bits sections run up to the section after them
+	if (!fitsInImage(header->slotsOffset, header->nSlots, sizeof(std::uint32_t), size)
+		|| !fitsInImage(header->groupsOffset, header->nGroups, sizeof(IndexGroup), size)
+		|| !fitsInImage(header->wordSlotsOffset, header->nWordSlots, sizeof(std::uint64_t), size)
+		|| header->charsOffset > header->bitsOffset || !fitsInImage(header->bitsOffset, 0, sizeof(std::uint64_t), size)
+		|| header->bitsOffset > header->wordSlotsOffset)
+		return false;
+	const IndexGroup* groups = reinterpret_cast<const IndexGroup*>(image + header->groupsOffset);
+	std::uint64_t nChars = header->bitsOffset - header->charsOffset;
+	std::uint64_t nBitBlocks = (header->wordSlotsOffset - header->bitsOffset) / sizeof(std::uint64_t);
+	for (std::uint32_t g = 0; g < header->nGroups; ++g)
+	{
+		const IndexGroup& group = groups[g];
+		if (group.nWords == 0 || group.length == 0 || group.length > MAX_PATTERN_LENGTH
+			|| group.words > nChars || group.nWords > (nChars - group.words) / group.length)
+			return false;
+		std::uint64_t groupBlocks = std::uint64_t(group.length) * 26 * bitsetBlocks(group);
+		if (group.bits != 0 && (group.bits - 1 > nBitBlocks || groupBlocks > nBitBlocks - (group.bits - 1)))
+			return false;
+	}
+	if (!slotsAreSound(reinterpret_cast<const std::uint32_t*>(image + header->slotsOffset), header->nSlots,
+			[header](std::uint32_t slot) { return slot <= header->nGroups; })
+		|| !slotsAreSound(reinterpret_cast<const std::uint64_t*>(image + header->wordSlotsOffset), header->nWordSlots,
+			[nChars](std::uint64_t slot) { return WordSlot::offset(slot) <= nChars && WordSlot::length(slot) <= nChars - WordSlot::offset(slot); }))
+		return false;
+
+	m_image = image;
+	m_header = header;
+	m_slots = reinterpret_cast<const std::uint32_t*>(image + header->slotsOffset);
+	m_groups = reinterpret_cast<const IndexGroup*>(image + header->groupsOffset);
+	m_chars = image + header->charsOffset;
+	m_bits = reinterpret_cast<const std::uint64_t*>(image + header->bitsOffset);
+	m_wordSlots = reinterpret_cast<const std::uint64_t*>(image + header->wordSlotsOffset);
 	return true;
 }
 
-bool WordListImpl::contains(string word) const
+bool WordListImpl::saveIndex(string filename) const
 {
-	// since we store our words as lowercase, we want to search through a lowercase version of the word
-	for (unsigned int i = 0; i < word.size(); ++i)
-		if (isalpha(word[i])) word[i] = tolower(word[i]);
+	if (!m_header) return false;	// nothing loaded, or a dawg
+	// write next to the target and rename, so a process that has the old index mapped is never disturbed
+	string tempname = filename + ".tmp";
+	{
+		ofstream out(tempname, ios::binary | ios::trunc);
+		if (!out) return false;
+		out.write(m_image, static_cast<streamsize>(m_header->imageSize));
+		if (!out) return false;
+	}
+	remove(filename.c_str());	// rename() won't replace an existing file everywhere
+	return rename(tempname.c_str(), filename.c_str()) == 0;
+}
 
-	string currPattern = getPattern(word);
-	vector<string>* wordList = m_patternToWords->find(currPattern);	// find the vector for the pattern of the word we're searching for
-	if (wordList)											// if the word pattern has been found
-		for (unsigned int i = 0; i < wordList->size(); ++i)	// search through the vector of all the words with that same pattern
-			if ((*wordList)[i] == word) return true;	// if we find it, return true. Otherwise return false
-	return false;	// return false if the pattern and/or word wasn't found
+const IndexGroup* WordListImpl::findGroup(const string& word) const
+{
+	PatternKey pattern;
+	if (!m_header || !getPattern(word.data(), word.size(), pattern)) return nullptr;	// nothing loaded, or a pattern no word can have
+	std::uint32_t mask = m_header->nSlots - 1;
+	std::uint32_t pos = static_cast<std::uint32_t>(hashPattern(pattern)) & mask;
+	for (; m_slots[pos] != 0; pos = (pos + 1) & mask)	// an empty slot ends the probe
+	{
+		const IndexGroup* group = &m_groups[m_slots[pos] - 1];
+		if (group->pattern == pattern)
+			return group;
+	}
+	return nullptr;
 }
 
-vector<string> WordListImpl::findCandidates(string cipherWord, string currTranslation) const
+bool WordListImpl::contains(const string& word) const
 {
-	vector<string> *possCandidates, allCandidates;	// initialize variables
+	Stats::count(&CrackStats::lookups);
+	Stats::Timer timer(&CrackStats::lookupTime);
+	if (m_usingDawg) return m_dawg.contains(word.data(), word.size());
+	if (!m_header || word.empty() || word.size() > MAX_PATTERN_LENGTH) return false;	// nothing loaded, or longer than every word we kept
+	std::uint64_t hash = hashWord(word.data(), word.size());
+	std::uint32_t mask = m_header->nWordSlots - 1;
+	for (std::uint32_t pos = static_cast<std::uint32_t>(hash) & mask; m_wordSlots[pos] != 0; pos = (pos + 1) & mask)	// an empty slot ends the probe
+	{
+		std::uint64_t slot = m_wordSlots[pos];
+		if (WordSlot::tag(slot) != WordSlot::hashTag(hash) || WordSlot::length(slot) != word.size()) continue;
+		const char* stored = m_chars + WordSlot::offset(slot);
+		unsigned int i = 0;	// we store our words as lowercase, so compare against a lowercase version of the word
+		while (i < word.size() && stored[i] == tolower(static_cast<unsigned char>(word[i])))
+			++i;
+		if (i == word.size()) return true;
+	}
+	return false;	// the word isn't in the list
+}
 
-	// since we store our words as lowercase, we want to search through a lowercase translation to see if it matches the word
-	for (unsigned int i = 0; i < currTranslation.size(); ++i)
-		if (isalpha(currTranslation[i])) currTranslation[i] = tolower(currTranslation[i]);
+void WordListImpl::findCandidates(const string& cipherWord, const string& currTranslation, vector<string_view>& candidates, string& storage) const
+{
+	candidates.clear();
+	storage.clear();
+	Stats::count(&CrackStats::lookups);
+	Stats::Timer timer(&CrackStats::lookupTime);
+	if (m_usingDawg)
+	{
+		// the matches all have the cipher word's length, so they go into storage back to back. the views
+		// are only made once it stops growing
+		m_dawg.forEachMatch(cipherWord, currTranslation, [&storage](const char* word, size_t length) { storage.append(word, length); });
+		for (size_t i = 0; i < storage.size(); i += cipherWord.size())
+			candidates.push_back(string_view(storage.data() + i, cipherWord.size()));
+		return;
+	}
+	const IndexGroup* group = findGroup(cipherWord);	// search for the pattern of the cipher word
+	if (!group || currTranslation.size() != group->length)	// no word has its pattern
+		return;
+	const char* words = m_chars + group->words;
 
-	possCandidates = m_patternToWords->find(getPattern(cipherWord));	// search for the pattern of the cipher word
-	if (possCandidates)	// if pattern exists
-		for (unsigned int i = 0; i < possCandidates->size(); ++i)	// run the pattern against the current translation
-			if (matchesTranslation((*possCandidates)[i], currTranslation))
-				allCandidates.push_back((*possCandidates)[i]);	// if a word has the proper pattern and matches the translation, add it to the vector
-	return allCandidates;
+	if (group->bits == 0)	// small group, just run the pattern against the current translation
+	{
+		TranslationTile tile;
+		makeTile(currTranslation, tile);
+		for (std::uint64_t matches = matchWords(words, group->nWords, tile); matches; matches &= matches - 1)
+			candidates.push_back(string_view(words + lowestBit(matches) * group->length, group->length));	// if a word has the proper pattern and matches the translation, add it to the vector
+		return;
+	}
+
+	// big group: the words that match are the ones in the bitset of every letter we know, at its position
+	std::uint32_t blocks = bitsetBlocks(*group);
+	const std::uint64_t* known[26];
+	unsigned int nKnown = knownBitsets(*group, currTranslation, known);
+	for (std::uint32_t b = 0; b < blocks; ++b)
+	{
+		std::uint64_t block = (b == blocks - 1 ? lastBlockMask(*group) : ~std::uint64_t(0));	// the last block is only partly words
+		for (unsigned int k = 0; k < nKnown && block; ++k)
+			block &= known[k][b];
+		for (; block; block &= block - 1)	// every set bit is a candidate
+			candidates.push_back(string_view(words + (b * 64 + lowestBit(block)) * group->length, group->length));
+	}
+}
+
+size_t WordListImpl::countCandidates(const string& cipherWord, const string& currTranslation) const
+{
+	Stats::count(&CrackStats::lookups);
+	Stats::Timer timer(&CrackStats::lookupTime);
+	if (m_usingDawg)
+	{
+		size_t count = 0;
+		m_dawg.forEachMatch(cipherWord, currTranslation, [&count](const char*, size_t) { count++; });
+		return count;
+	}
+	const IndexGroup* group = findGroup(cipherWord);
+	if (!group || currTranslation.size() != group->length)
+		return 0;
+	size_t count = 0;
+	if (group->bits == 0)
+	{
+		TranslationTile tile;
+		makeTile(currTranslation, tile);
+		return countBits(matchWords(m_chars + group->words, group->nWords, tile));
+	}
+	std::uint32_t blocks = bitsetBlocks(*group);
+	const std::uint64_t* known[26];
+	unsigned int nKnown = knownBitsets(*group, currTranslation, known);
+	if (nKnown == 0)	// no letters known, so the whole group matches
+		return group->nWords;
+	for (std::uint32_t b = 0; b < blocks; ++b)	// same as findCandidates, but we only need to count the bits
+	{
+		std::uint64_t block = (b == blocks - 1 ? lastBlockMask(*group) : ~std::uint64_t(0));
+		for (unsigned int k = 0; k < nKnown && block; ++k)
+			block &= known[k][b];
+		count += countBits(block);
+	}
+	return count;
+}
+
+size_t WordListImpl::memoryUsage() const
+{
+	if (m_usingDawg)
+		return m_dawg.memoryUsage();
+	return m_header ? static_cast<size_t>(m_header->imageSize) : 0;
+}
+
+unsigned int WordListImpl::knownBitsets(const IndexGroup& group, const string& currTranslation, const std::uint64_t* known[26]) const
+{
+	// a letter that repeats only needs its first position, the pattern already makes the rest agree
+	std::uint32_t blocks = bitsetBlocks(group);
+	unsigned int nKnown = 0;
+	bool seen[26] = { false };
+	for (unsigned int pos = 0; pos < currTranslation.size(); ++pos)
+	{
+		unsigned char c = currTranslation[pos];
+		if (!isalpha(c)) continue;	// unknown letters, and the apostrophes the pattern already matched
+		int letter = tolower(c) - 'a';
+		if (seen[letter]) continue;
+		seen[letter] = true;
+		known[nKnown++] = m_bits + (group.bits - 1) + (pos * 26 + letter) * blocks;
+	}
+	return nKnown;
 }
 
 
@@ -156,17 +868,46 @@ WordList::~WordList()
     delete m_impl;
 }
 
+void WordList::setBackend(WordListBackend backend)
+{
+    m_impl->setBackend(backend);
+}
+
 bool WordList::loadWordList(string filename)
 {
     return m_impl->loadWordList(filename);
 }
 
+bool WordList::saveIndex(string filename) const
+{
+    return m_impl->saveIndex(filename);
+}
+
 bool WordList::contains(string word) const
 {
     return m_impl->contains(word);
 }
 
-vector<string> WordList::findCandidates(string cipherWord, string currTranslation) const
+vector<string> WordList::findCandidates(const string& cipherWord, const string& currTranslation) const
+{
+    vector<string_view> views;
+    string storage;
+    m_impl->findCandidates(cipherWord, currTranslation, views, storage);
+    return vector<string>(views.begin(), views.end());
+}
+
+void WordList::findCandidates(const string& cipherWord, const string& currTranslation, vector<string_view>& candidates,
+                              string& storage) const
+{
+    m_impl->findCandidates(cipherWord, currTranslation, candidates, storage);
+}
+
+size_t WordList::countCandidates(const string& cipherWord, const string& currTranslation) const
+{
+    return m_impl->countCandidates(cipherWord, currTranslation);
+}
+
+size_t WordList::memoryUsage() const
 {
-   return m_impl->findCandidates(cipherWord, currTranslation);
+    return m_impl->memoryUsage();
 }
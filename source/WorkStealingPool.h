@@ -0,0 +1,158 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////
+// WorkStealingPool Interface
+/////////////////////////////////////////////////////////////
+
+// A fixed set of worker threads, each with its own deque of tasks. A worker
+// pops its newest task first (depth-first, good locality); when it runs dry it
+// steals the oldest task of another worker (the biggest remaining subtree).
+// Tasks receive the index of the worker running them so they can use
+// per-worker state and spawn() children onto that worker's deque.
+class WorkStealingPool
+{
+public:
+	typedef std::function<void(unsigned int)> Task;
+
+	WorkStealingPool(unsigned int nThreads)
+		:m_queues(nThreads == 0 ? 1 : nThreads), m_pending(0), m_queued(0), m_stop(false)
+	{
+		for (unsigned int i = 0; i < m_queues.size(); ++i)
+			m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+	}
+	~WorkStealingPool();
+
+	unsigned int size() const { return static_cast<unsigned int>(m_queues.size()); }
+	void submit(Task task);						// add a task from outside the pool
+	void spawn(unsigned int worker, Task task);	// add a task from inside a running task
+	void wait();								// block until every task has finished
+
+	// C++11 syntax for preventing copying and assignment
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+private:
+	struct Queue {
+		std::mutex       lock;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<Queue>       m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<unsigned int> m_nextQueue{0};	// round robin target for submit()
+	std::mutex               m_sleepLock;		// guards the counters and m_stop for the condition variables
+	std::condition_variable  m_workReady;
+	std::condition_variable  m_allDone;
+	unsigned long            m_pending;			// tasks queued or running
+	long                     m_queued;			// tasks sitting in some deque (may dip below 0 briefly)
+	bool                     m_stop;
+
+	void push(unsigned int queue, Task task)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_sleepLock);
+			m_pending++;		// count it before anyone can run it
+		}
+		{
+			std::lock_guard<std::mutex> guard(m_queues[queue].lock);
+			m_queues[queue].tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> guard(m_sleepLock);
+			m_queued++;			// only now can a sleeping worker find it
+		}
+		m_workReady.notify_one();
+	}
+	// take the newest task of our own queue, or else the oldest task of someone else's
+	bool takeTask(unsigned int worker, Task& task)
+	{
+		{
+			Queue& own = m_queues[worker];
+			std::lock_guard<std::mutex> guard(own.lock);
+			if (!own.tasks.empty())
+			{
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+		for (unsigned int i = 1; i < m_queues.size(); ++i)
+		{
+			Queue& victim = m_queues[(worker + i) % m_queues.size()];
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (!victim.tasks.empty())
+			{
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+	void workerLoop(unsigned int worker)
+	{
+		Task task;
+		for (;;)
+		{
+			if (takeTask(worker, task))
+			{
+				{
+					std::lock_guard<std::mutex> guard(m_sleepLock);
+					m_queued--;
+				}
+				task(worker);
+				task = nullptr;
+				std::lock_guard<std::mutex> guard(m_sleepLock);
+				if (--m_pending == 0)
+					m_allDone.notify_all();
+				continue;
+			}
+			std::unique_lock<std::mutex> guard(m_sleepLock);
+			m_workReady.wait(guard, [this] { return m_queued > 0 || m_stop; });
+			if (m_stop && m_queued == 0) return;
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////
+// Public Member Function Implementations
+/////////////////////////////////////////////////////////////////
+
+inline WorkStealingPool::~WorkStealingPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(m_sleepLock);
+		m_stop = true;
+	}
+	m_workReady.notify_all();
+	for (unsigned int i = 0; i < m_threads.size(); ++i)
+		m_threads[i].join();
+}
+
+inline void WorkStealingPool::submit(Task task)
+{
+	push(m_nextQueue++ % m_queues.size(), std::move(task));
+}
+
+inline void WorkStealingPool::spawn(unsigned int worker, Task task)
+{
+	push(worker, std::move(task));
+}
+
+inline void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> guard(m_sleepLock);
+	m_allDone.wait(guard, [this] { return m_pending == 0; });
+}
+
+#endif // WORK_STEALING_POOL_H
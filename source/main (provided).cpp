@@ -1,51 +1,286 @@
 #include "provided.h"
 #include "MyHash.h"
+#include "Stats.h"
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
 #include <cctype>
 #include <random>
 #include <algorithm>
-#include <numeric>
+#include <iomanip>
+#include <atomic>
+#include <csignal>
 using namespace std;
 
 const string WORDLIST_FILE = "largewordlist.txt";
+// candidate lists remembered between the cracks of a server or batch run
+const size_t CANDIDATE_CACHE_SIZE = 1 << 16;
+// how the word list is kept, set by -W
+WordListBackend wordListBackend = WordListBackend::Index;
+
+// set by ctrl-c, so a long crack stops and prints what it found instead of the process just dying
+atomic<bool> interrupted(false);
+
+extern "C" void stopOnInterrupt(int)
+{
+	interrupted = true;
+}
+
+// cracks from here on stop at the first ctrl-c
+CrackOptions interruptible(CrackOptions options)
+{
+	signal(SIGINT, stopOnInterrupt);
+	options.cancel = &interrupted;
+	return options;
+}
 
 string encrypt(string plaintext)
 {
-	  // Generate a to z
-    char plaintextAlphabet[26+1];
-	iota(plaintextAlphabet, plaintextAlphabet+26, 'a');
-	plaintextAlphabet[26] = '\0';
+	return encrypt(plaintext, random_device()());	// a fresh key every time
+}
+
+// the stats of a crack as one line of JSON
+void printStats(ostream& out, const CrackStats& stats)
+{
+	out << "{\"nodes\":" << stats.nodes << ",\"maxDepth\":" << stats.maxDepth;
+	if (stats.transpositionHits + stats.transpositionMisses > 0)
+		out << ",\"transpositionHits\":" << stats.transpositionHits << ",\"transpositionMisses\":" << stats.transpositionMisses;
+	if (Stats::ENABLED)
+	{
+		out << ",\"candidates\":" << stats.candidates << ",\"pushRejections\":" << stats.pushRejections
+			<< ",\"validationFailures\":" << stats.validationFailures << ",\"lookups\":" << stats.lookups
+			<< ",\"translations\":" << stats.translations
+			<< ",\"tokenizeNs\":" << stats.tokenizeTime.count() << ",\"translateNs\":" << stats.translateTime.count()
+			<< ",\"validateNs\":" << stats.validateTime.count() << ",\"lookupNs\":" << stats.lookupTime.count();
+	}
+	out << "}" << endl;
+}
+
+bool decrypt(string ciphertext, unsigned int nThreads, const CrackOptions& limits, bool sorted, size_t best, bool verbose)
+{
+	CrackOptions options = interruptible(limits);
+	Decrypter d;
+	d.setThreadCount(nThreads);
+	d.setWordListBackend(wordListBackend);
+	if ( ! d.load(WORDLIST_FILE))
+	{
+		cout << "Unable to load word list file " << WORDLIST_FILE << endl;
+		return false;
+	}
+	if (best > 0)	// only the most english looking ones, best first
+	{
+		BestCrackResult result = d.crackBest(ciphertext, best, options);
+		for (const auto& s : result.solutions)
+			cout << fixed << setprecision(2) << s.score << '\t' << s.plaintext << endl;
+		if (verbose)
+			printStats(cerr, result.stats);
+	}
+	else if (sorted)
+	{
+		CrackResult result = d.crack(ciphertext, options);
+		for (const auto& s : result.solutions)
+			cout << s << endl;
+		if (verbose)
+			printStats(cerr, result.stats);
+	}
+	else	// print each one as soon as it's found
+	{
+		CrackStats stats;
+		d.crack(ciphertext, [](const string& s) {
+			cout << s << endl;
+			return true;
+		}, options, stats);
+		if (verbose)
+			printStats(cerr, stats);
+	}
+	return true;
+}
+
+bool serve(string where, unsigned int nThreads, const CrackOptions& options)
+{
+	Decrypter d;	// loaded once, shared by every request
+	d.setWordListBackend(wordListBackend);
+	if ( ! d.load(WORDLIST_FILE))
+	{
+		cerr << "Unable to load word list file " << WORDLIST_FILE << endl;
+		return false;
+	}
+	d.setCacheSize(CANDIDATE_CACHE_SIZE);
+	DecryptServer server(d, nThreads, options);
+	if (where == "-")
+		return server.serve(cin, cout);
+	return server.serveSocket(where);
+}
 
-	  // Generate permutation
-	string ciphertextAlphabet(plaintextAlphabet);
-	default_random_engine e((random_device()()));
-	shuffle(ciphertextAlphabet.begin(), ciphertextAlphabet.end(), e);
+bool batch(string filename, unsigned int nThreads, const CrackOptions& options)
+{
+	Decrypter d;
+	d.setWordListBackend(wordListBackend);
+	if ( ! d.load(WORDLIST_FILE))
+	{
+		cerr << "Unable to load word list file " << WORDLIST_FILE << endl;
+		return false;
+	}
+	d.setCacheSize(CANDIDATE_CACHE_SIZE);
+	DecryptServer server(d, nThreads, options);
+	if (filename == "-")
+		return server.serveOrdered(cin, cout);
+	ifstream in(filename);
+	if ( ! in)
+	{
+		cerr << "Unable to open " << filename << endl;
+		return false;
+	}
+	return server.serveOrdered(in, cout);
+}
 
-	  // Run translator (opposite to the intended direction)
-	Translator t;
-	t.pushMapping(plaintextAlphabet, ciphertextAlphabet);
-	return t.getTranslation(plaintext);
+// cracks every line of a file as messages that share one key
+bool crackShared(string filename, unsigned int nThreads, const CrackOptions& limits, bool verbose)
+{
+	CrackOptions options = interruptible(limits);
+	vector<string> ciphertexts;
+	{
+		ifstream file;
+		if (filename != "-")
+		{
+			file.open(filename);
+			if ( ! file)
+			{
+				cerr << "Unable to open " << filename << endl;
+				return false;
+			}
+		}
+		istream& in = (filename == "-" ? cin : file);
+		string line;
+		while (getline(in, line))
+			if (!line.empty())
+				ciphertexts.push_back(line);
+	}
+	Decrypter d;
+	d.setThreadCount(nThreads);
+	d.setWordListBackend(wordListBackend);
+	if ( ! d.load(WORDLIST_FILE))
+	{
+		cout << "Unable to load word list file " << WORDLIST_FILE << endl;
+		return false;
+	}
+	SharedKeyResult result = d.crackShared(ciphertexts, options);
+	for (const auto& s : result.solutions)	// the key, then what it makes of each line, then a blank line
+	{
+		cout << "key\t" << s.key << endl;
+		for (const auto& plaintext : s.plaintexts)
+			cout << plaintext << endl;
+		cout << endl;
+	}
+	if (verbose)
+		printStats(cerr, result.stats);
+	return true;
 }
 
-bool decrypt(string ciphertext)
+bool anneal(string ciphertext, unsigned int nThreads, const CrackOptions& limits, bool verbose)
 {
+	CrackOptions options = interruptible(limits);
 	Decrypter d;
+	d.setThreadCount(nThreads);
+	d.setWordListBackend(wordListBackend);
 	if ( ! d.load(WORDLIST_FILE))
 	{
 		cout << "Unable to load word list file " << WORDLIST_FILE << endl;
 		return false;
 	}
-	for (const auto& s : d.crack(ciphertext))
-		cout << s << endl;
+	AnnealResult result = d.crackAnneal(ciphertext, options);
+	for (const auto& s : result.solutions)	// best first, with the key and how many words the list knew
+		cout << fixed << setprecision(2) << s.score << '\t' << s.key << '\t' << s.knownWords << '\t' << s.plaintext << endl;
+	if (verbose)
+		cerr << "{\"iterations\":" << result.iterations << ",\"truncated\":" << (result.truncated ? "true" : "false") << "}" << endl;
+	return true;
+}
+
+bool buildIndex(string filename)
+{
+	WordList wl;
+	if ( ! wl.loadWordList(filename))
+	{
+		cout << "Unable to load word list file " << filename << endl;
+		return false;
+	}
+	if ( ! wl.saveIndex(filename + ".idx"))
+	{
+		cout << "Unable to write index file " << filename << ".idx" << endl;
+		return false;
+	}
 	return true;
 }
 
 int main(int argc, char* argv[])
 {
-	if (argc == 3  &&  argv[1][0] == '-')
+	unsigned int nThreads = 1;
+	bool threadsGiven = false;	// the server and batch modes default to every core instead
+	CrackOptions options;
+	bool sorted = true;
+	size_t best = 0;
+	bool verbose = false;
+	bool goodOptions = (argc >= 3);
+	for (int i = 3; goodOptions  &&  i < argc; i++)	// optional settings after the message
+	{
+		if (strcmp(argv[i], "-u") == 0)
+			sorted = false;
+		else if (strcmp(argv[i], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[i], "-P") == 0)
+			options.propagate = false;
+		else if (i + 1 == argc)	// the rest all take a value
+			goodOptions = false;
+		else if (strcmp(argv[i], "-t") == 0)
+		{
+			nThreads = atoi(argv[++i]);
+			threadsGiven = true;
+		}
+		else if (strcmp(argv[i], "-T") == 0)
+			options.timeout = chrono::milliseconds(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-n") == 0)
+			options.maxResults = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-N") == 0)
+			options.maxNodes = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-x") == 0)
+			options.transpositionEntries = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-U") == 0)
+			options.unknownWords = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0)
+			best = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0)
+			options.restarts = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-I") == 0)
+			options.iterations = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-w") == 0)
+			options.beamWidth = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-W") == 0)
+		{
+			string backend = argv[++i];
+			if (backend == "index")
+				wordListBackend = WordListBackend::Index;
+			else if (backend == "dawg")
+				wordListBackend = WordListBackend::Dawg;
+			else
+				goodOptions = false;
+		}
+		else if (strcmp(argv[i], "-o") == 0)
+		{
+			string order = argv[++i];
+			if (order == "fewest")
+				options.order = WordOrder::FewestCandidates;
+			else if (order == "unknown")
+				options.order = WordOrder::MostUnknown;
+			else
+				goodOptions = false;
+		}
+		else
+			goodOptions = false;
+	}
+	if (goodOptions  &&  argv[1][0] == '-')
 	{
 		switch (tolower(argv[1][1]))
 		{
@@ -53,13 +288,47 @@ int main(int argc, char* argv[])
 			cout << encrypt(argv[2]) << endl;
 			return 0;
 		  case 'd':
-			if (decrypt(argv[2]))
+			if (decrypt(argv[2], nThreads, options, sorted, best, verbose))
+				return 0;
+			return 1;
+		  case 'i':
+			if (buildIndex(argv[2]))
+				return 0;
+			return 1;
+		  case 's':
+			if (serve(argv[2], threadsGiven ? nThreads : 0, options))
+				return 0;
+			return 1;
+		  case 'b':
+			if (batch(argv[2], threadsGiven ? nThreads : 0, options))
+				return 0;
+			return 1;
+		  case 'a':
+			if (anneal(argv[2], nThreads, options, verbose))
+				return 0;
+			return 1;
+		  case 'm':
+			if (crackShared(argv[2], nThreads, options, verbose))
 				return 0;
 			return 1;
 		}
 	}
 
 	cout << "Usage to encrypt:  " << argv[0] << " -e \"Your message here.\"" << endl;
-	cout << "Usage to decrypt:  " << argv[0] << " -d \"Uwey tirrboi miyi.\"" << endl;
+	cout << "Usage to decrypt:  " << argv[0] << " -d \"Uwey tirrboi miyi.\" [-t threads] [-T timeout ms] [-N max nodes] [-n max results] [-u] [-k best] [-w beam width] [-v] [-P] [-o fewest|unknown] [-x entries] [-U unknown words] [-W index|dawg]" << endl;
+	cout << "  (-t 0 uses one thread per core, -u prints solutions unsorted as soon as they are found," << endl;
+	cout << "   -k 5 prints just the 5 most english looking solutions with their scores," << endl;
+	cout << "   -v prints the search's statistics as JSON on stderr, -P turns off constraint propagation," << endl;
+	cout << "   -o picks the next word by fewest candidates (default) or most unknown letters," << endl;
+	cout << "   -N stops after searching about that many nodes, and ctrl-c stops early and prints what was found," << endl;
+	cout << "   -x remembers up to that many dead ends, to skip them when another order of guesses gets there," << endl;
+	cout << "   -U 1 also finds solutions with one word that isn't in the list, like a name, after the ones without," << endl;
+	cout << "   -W dawg keeps the word list as a compressed word graph instead of an index, for huge lists)" << endl;
+	cout << "Usage to anneal:   " << argv[0] << " -a \"Uwey tirrboi miyi.\" [-t threads] [-T timeout ms] [-N max iterations] [-n max results] [-r restarts] [-I iterations] [-v] [-W index|dawg]" << endl;
+	cout << "  (prints the best keys simulated annealing finds, each with its score, key and number of known words)" << endl;
+	cout << "Usage to index:    " << argv[0] << " -i " << WORDLIST_FILE << endl;
+	cout << "Usage to serve:    " << argv[0] << " -s <- for stdin | socket path> [-t threads] [-T timeout ms] [-N max nodes] [-n max results] [-W index|dawg]" << endl;
+	cout << "Usage for a batch: " << argv[0] << " -b <file of ciphertexts, one per line | - for stdin> [-t threads] [-T timeout ms] [-N max nodes] [-n max results] [-W index|dawg]" << endl;
+	cout << "Usage for one key: " << argv[0] << " -m <file of ciphertexts sharing a key, one per line | - for stdin> [-t threads] [-T timeout ms] [-N max nodes] [-n max results] [-v] [-W index|dawg]" << endl;
 	return 1;
 }
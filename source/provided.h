@@ -1,7 +1,13 @@
 #ifndef PROVIDED_INCLUDED
 #define PROVIDED_INCLUDED
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class TokenizerImpl;
@@ -12,6 +18,9 @@ public:
     Tokenizer(std::string separators);
     ~Tokenizer();
     std::vector<std::string> tokenize(const std::string& s) const;
+      // Same tokens, as views into s, in a vector the caller can reuse so
+      // that nothing is allocated once it's big enough.
+    void tokenize(const std::string& s, std::vector<std::string_view>& tokens) const;
       // We prevent a Tokenizer object from being copied or assigned.
     Tokenizer(const Tokenizer&) = delete;
     Tokenizer& operator=(const Tokenizer&) = delete;
@@ -21,14 +30,37 @@ private:
 
 class WordListImpl;
 
+  // How a WordList keeps its words. Index is fastest and can be saved and
+  // mapped; Dawg shares the prefixes and endings words have in common, for
+  // lists too big to keep that way.
+enum class WordListBackend { Index, Dawg };
+
 class WordList
 {
 public:
     WordList();
     ~WordList();
+      // Which backend the next loadWordList builds. Index by default.
+    void setBackend(WordListBackend backend);
+      // Loads filename + ".idx" instead of the text file when it exists
+      // and matches the text file's size and modification time.
     bool loadWordList(std::string filename);
+      // Writes the loaded list as an index file that loadWordList can map
+      // straight into memory. Index backend only.
+    bool saveIndex(std::string filename) const;
     bool contains(std::string word) const;
-    std::vector<std::string> findCandidates(std::string cipherWord, std::string currTranslation) const;
+    std::vector<std::string> findCandidates(const std::string& cipherWord, const std::string& currTranslation) const;
+      // The same, but fills candidates with views instead of copies. With
+      // the Index backend they are views of the words inside the list, valid
+      // until it is loaded again or destroyed, and storage is left empty.
+      // The Dawg backend holds no word text, so it copies the words into
+      // storage and the views last only until storage changes.
+    void findCandidates(const std::string& cipherWord, const std::string& currTranslation,
+                        std::vector<std::string_view>& candidates, std::string& storage) const;
+      // How many candidates findCandidates would find, without listing them.
+    std::size_t countCandidates(const std::string& cipherWord, const std::string& currTranslation) const;
+      // Bytes the loaded list takes up, not counting the object itself.
+    std::size_t memoryUsage() const;
       // We prevent a WordList object from being copied or assigned.
     WordList(const WordList&) = delete;
     WordList& operator=(const WordList&) = delete;
@@ -53,6 +85,121 @@ private:
     TranslatorImpl* m_impl;
 };
 
+  // Encrypts plaintext with a random substitution key. The same seed gives
+  // the same key on every platform, so test ciphertexts can be reproduced.
+std::string encrypt(const std::string& plaintext, unsigned int seed);
+
+  // Which word the crack guesses next.
+enum class WordOrder
+{
+    FewestCandidates,                    // the word with the fewest candidates left (fails fastest)
+    MostUnknown                          // the word with the most unknown letters, longest on ties
+};
+
+struct CrackOptions
+{
+    CrackOptions() : maxResults(0), timeout(0), maxNodes(0), cancel(nullptr), beamWidth(0), propagate(true),
+                     order(WordOrder::FewestCandidates), transpositionEntries(0), unknownWords(0), restarts(16), iterations(20000) {}
+    std::size_t maxResults;              // stop after this many solutions, 0 for all of them
+    std::chrono::milliseconds timeout;   // stop after this long, 0 for no limit
+    unsigned long long maxNodes;         // stop after searching about this many nodes, 0 for no limit
+    const std::atomic<bool>* cancel;     // stop soon after another thread sets this to true, nullptr
+                                         // for no way to cancel. must outlive the crack
+    std::size_t beamWidth;               // crackBest: candidates tried per word, 0 for all (exact)
+    bool propagate;                      // crack: after each guess, narrow down what every letter can
+                                         // still be and fill in words left with one candidate
+    WordOrder order;                     // crack: which word to guess next
+    std::size_t transpositionEntries;    // crack: remember about this many search states that turned
+                                         // out to have no solutions, and skip them when another
+                                         // order of guesses gets there again. 0 turns it off
+    std::size_t unknownWords;            // crack: how many words may translate to something that isn't
+                                         // in the list, for names and typos. solutions with fewer come
+                                         // first, and letters only such words have stay '?'
+    std::size_t restarts;                // crackAnneal: climbs from fresh random keys
+    unsigned long long iterations;       // crackAnneal: key changes tried in each climb. maxNodes
+                                         // caps the changes of all climbs together
+};
+
+  // What a crack spent its time on. nodes and maxDepth are always counted,
+  // the rest only in builds with CRACKER_STATS defined (see Stats.h).
+struct CrackStats
+{
+    CrackStats() : nodes(0), candidates(0), pushRejections(0), validationFailures(0), lookups(0),
+                   translations(0), transpositionHits(0), transpositionMisses(0), maxDepth(0),
+                   tokenizeTime(0), translateTime(0), validateTime(0), lookupTime(0) {}
+    unsigned long long nodes;               // candidates the search tried, to see how well it prunes
+    unsigned long long candidates;          // candidates the word list handed back
+    unsigned long long pushRejections;      // mappings the translator refused as contradictions
+    unsigned long long validationFailures;  // pushes that finished a word that isn't in the list
+    unsigned long long lookups;             // word list queries
+    unsigned long long translations;        // Translator::getTranslation calls
+    unsigned long long transpositionHits;   // states skipped because the table knew they were dead
+    unsigned long long transpositionMisses; // states looked up and searched
+    unsigned int maxDepth;                  // most words guessed at once
+    std::chrono::nanoseconds tokenizeTime;
+    std::chrono::nanoseconds translateTime;
+    std::chrono::nanoseconds validateTime;  // checking finished words against the list
+    std::chrono::nanoseconds lookupTime;    // in the word list, validation included
+};
+
+struct CrackResult
+{
+    CrackResult() : truncated(false) {}
+    std::vector<std::string> solutions;  // sorted
+    bool truncated;                      // a limit in the CrackOptions cut the search short
+    CrackStats stats;
+};
+
+struct ScoredSolution
+{
+    std::string plaintext;
+    double score;                        // log10 likelihood under English letter statistics
+};
+
+struct BestCrackResult
+{
+    BestCrackResult() : truncated(false) {}
+    std::vector<ScoredSolution> solutions;  // best score first
+    bool truncated;                      // the beam width or timeout may have skipped better solutions
+    CrackStats stats;                    // nodes are the partial keys the search expanded
+};
+
+struct SharedKeySolution
+{
+    std::string key;                     // the plaintext letter for each cipher letter from 'a' to 'z',
+                                         // '?' for letters none of the ciphertexts use
+    std::vector<std::string> plaintexts; // one per ciphertext, in the same order
+};
+
+struct SharedKeyResult
+{
+    SharedKeyResult() : truncated(false) {}
+    std::vector<SharedKeySolution> solutions;  // sorted by plaintexts
+    bool truncated;                      // a limit in the CrackOptions cut the search short
+    CrackStats stats;
+};
+
+struct AnnealSolution
+{
+    std::string key;                     // the plaintext letter for each cipher letter from 'a' to 'z',
+                                         // '?' for letters the ciphertext doesn't use
+    std::string plaintext;
+    double score;                        // log10 English letter statistics plus a bonus for every
+                                         // letter of a word in the list. higher is better
+    std::size_t knownWords;              // words of the plaintext that are in the list
+};
+
+struct AnnealResult
+{
+    AnnealResult() : truncated(false), iterations(0) {}
+    std::vector<AnnealSolution> solutions;  // best score first, no two with the same plaintext
+    bool truncated;                      // a limit in the CrackOptions cut the climbs short
+    unsigned long long iterations;       // key changes tried, over all the climbs
+};
+
+  // Called with each solution as it is found. Return false to stop the crack.
+typedef std::function<bool(const std::string& plaintext)> SolutionVisitor;
+
 class DecrypterImpl;
 
 class Decrypter
@@ -61,7 +208,47 @@ public:
     Decrypter();
     ~Decrypter();
     bool load(std::string filename);
+      // Number of threads crack() searches with: 1 (the default) stays on
+      // the calling thread, 0 means one per hardware core.
+    void setThreadCount(unsigned int nThreads);
+      // Remember up to maxEntries candidate lists across cracks, shared by
+      // every thread, for when many messages get cracked against one list.
+      // 0 (the default) turns it off.
+    void setCacheSize(std::size_t maxEntries);
+      // Which WordList backend load() uses. Index by default.
+    void setWordListBackend(WordListBackend backend);
     std::vector<std::string> crack(const std::string& ciphertext);
+      // Like crack() above, but the search stops early at the limits in
+      // options. Safe to call from several threads at once.
+    CrackResult crack(const std::string& ciphertext, const CrackOptions& options) const;
+      // Streams each solution to visit as soon as the search finds it,
+      // unsorted and one call at a time even with several threads. Stops
+      // when visit returns false or a limit is hit. Returns false if the
+      // search was cut short.
+    bool crack(const std::string& ciphertext, const SolutionVisitor& visit,
+               const CrackOptions& options = CrackOptions()) const;
+      // The same, and fills in stats once the crack is over.
+    bool crack(const std::string& ciphertext, const SolutionVisitor& visit,
+               const CrackOptions& options, CrackStats& stats) const;
+      // Finds the k solutions that look most like English, trying the most
+      // promising candidates first and skipping every branch that can't
+      // beat the k-th best found so far. Single threaded.
+    BestCrackResult crackBest(const std::string& ciphertext, std::size_t k,
+                              const CrackOptions& options = CrackOptions()) const;
+      // Cracks several ciphertexts that were encrypted with the same key at
+      // once: each solution is a key that turns every one of them into real
+      // words. The long ones pin down letters for the short ones.
+    SharedKeyResult crackShared(const std::vector<std::string>& ciphertexts,
+                                const CrackOptions& options = CrackOptions()) const;
+      // Looks for the key by simulated annealing instead of an exact
+      // search: options.restarts climbs from random keys, run on the
+      // threads of setThreadCount, each swapping plaintext letters to raise
+      // the score. Words missing from the list only cost score, so this
+      // still works on long messages and on ones with names or typos, but
+      // the best key found isn't guaranteed to be right. Returns the best
+      // options.maxResults keys (0 for one per climb).
+    AnnealResult crackAnneal(const std::string& ciphertext,
+                             const CrackOptions& options = CrackOptions()) const;
       // We prevent a Decrypter object from being copied or assigned.
     Decrypter(const Decrypter&) = delete;
     Decrypter& operator=(const Decrypter&) = delete;
@@ -69,4 +256,29 @@ private:
     DecrypterImpl* m_impl;
 };
 
+class DecryptServerImpl;
+
+class DecryptServer
+{
+public:
+      // Cracks newline-delimited requests against an already loaded
+      // Decrypter, nThreads at a time (0 for one per core), each one
+      // limited by options. See Server.cpp for the line protocol.
+    DecryptServer(const Decrypter& decrypter, unsigned int nThreads, const CrackOptions& options);
+    ~DecryptServer();
+      // Serves requests read from in until it ends, answering on out.
+    bool serve(std::istream& in, std::ostream& out);
+      // Like serve(), but writes the answers in the order the requests came
+      // in, for cracking a file of ciphertexts.
+    bool serveOrdered(std::istream& in, std::ostream& out);
+      // Listens on a Unix domain socket, serving every connection like
+      // serve(). Only returns if the socket fails.
+    bool serveSocket(const std::string& path);
+      // We prevent a DecryptServer object from being copied or assigned.
+    DecryptServer(const DecryptServer&) = delete;
+    DecryptServer& operator=(const DecryptServer&) = delete;
+private:
+    DecryptServerImpl* m_impl;
+};
+
 #endif // PROVIDED_INCLUDED
@@ -0,0 +1,69 @@
+# runs Cracked once for a test and checks what it printed. called by ctest as
+#   cmake -DCRACKED=<program> -DWORKDIR=<dir with the word list> -DARGS=<args, | separated> [...] -P check.cmake
+# and then, depending on what else is set:
+#   EXPECTED=<file>    the output has to be exactly that file
+#   SAME_AS=<args>     the output has to be what Cracked prints for those args instead
+#   NONEMPTY=ON        it has to print something
+#   UNIQUE=ON          no line can come out twice
+#   SORT=ON            sort the lines of both outputs before comparing, for -u
+#   INPUT=<file>       fed to Cracked on stdin
+
+function(run_cracked argString outVar)
+	string(REPLACE "|" ";" args "${argString}")
+	if(INPUT)
+		execute_process(COMMAND ${CRACKED} ${args} WORKING_DIRECTORY ${WORKDIR} INPUT_FILE ${INPUT}
+			OUTPUT_VARIABLE out RESULT_VARIABLE result)
+	else()
+		execute_process(COMMAND ${CRACKED} ${args} WORKING_DIRECTORY ${WORKDIR}
+			OUTPUT_VARIABLE out RESULT_VARIABLE result)
+	endif()
+	if(NOT result EQUAL 0)
+		string(REPLACE "|" " " command "${argString}")
+		message(FATAL_ERROR "Cracked ${command} failed: ${result}")
+	endif()
+	if(SORT)	# the corpus never prints a ; or [, so lines can go through a cmake list
+		string(REGEX REPLACE "\n$" "" out "${out}")
+		string(REPLACE "\n" ";" lines "${out}")
+		list(SORT lines)
+		string(REPLACE ";" "\n" out "${lines}")
+		if(NOT out STREQUAL "")
+			string(APPEND out "\n")
+		endif()
+	endif()
+	set(${outVar} "${out}" PARENT_SCOPE)
+endfunction()
+
+string(REPLACE "|" " " command "${ARGS}")	# for the messages
+string(REPLACE "|" " " otherCommand "${SAME_AS}")
+run_cracked("${ARGS}" actual)
+
+if(NONEMPTY AND actual STREQUAL "")
+	message(FATAL_ERROR "Cracked ${command} printed nothing")
+endif()
+
+if(UNIQUE)
+	string(REGEX REPLACE "\n$" "" lines "${actual}")
+	string(REPLACE "\n" ";" lines "${lines}")
+	list(LENGTH lines before)
+	list(REMOVE_DUPLICATES lines)
+	list(LENGTH lines after)
+	if(NOT before EQUAL after)
+		message(FATAL_ERROR "Cracked ${command} printed ${before} lines but only ${after} different ones")
+	endif()
+endif()
+
+if(EXPECTED)
+	file(READ ${EXPECTED} expected)
+	if(NOT actual STREQUAL expected)
+		get_filename_component(name ${EXPECTED} NAME)
+		file(WRITE ${WORKDIR}/${name}.actual "${actual}")	# to diff against the expected output
+		message(FATAL_ERROR "Cracked ${command} didn't print ${EXPECTED}, see ${WORKDIR}/${name}.actual")
+	endif()
+endif()
+
+if(SAME_AS)
+	run_cracked("${SAME_AS}" other)
+	if(NOT actual STREQUAL other)
+		message(FATAL_ERROR "Cracked ${command} and Cracked ${otherCommand} printed different solutions")
+	endif()
+endif()